@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+//Fixed size set of positions stored as 64 bits words.
+//The word loops are kept simple so that the compiler could vectorize them
+class Bitmap {
+public:
+    Bitmap() : bits_count(0) {}
+
+    explicit Bitmap(const size_t bits_count, const bool value = false) :
+            words((bits_count + 63) / 64, value ? ~(uint64_t) 0 : 0), bits_count(bits_count) {
+        clearPadding();
+    }
+
+    inline size_t size() const {
+        return bits_count;
+    }
+
+    inline void set(const size_t position) {
+        words[position / 64] |= (uint64_t) 1 << (position % 64);
+    }
+
+    inline bool test(const size_t position) const {
+        return (words[position / 64] >> (position % 64)) & 1;
+    }
+
+    //Sets all the bits to value, keeping the size
+    void fill(const bool value) {
+        std::fill(words.begin(), words.end(), value ? ~(uint64_t) 0 : 0);
+        clearPadding();
+    }
+
+    //The two bitmaps should have the same size
+    void andWith(const Bitmap &other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] &= other.words[i];
+        }
+    }
+
+    size_t count() const {
+        size_t count = 0;
+        for (const auto word : words) {
+            count += __builtin_popcountll(word);
+        }
+        return count;
+    }
+
+    //Size of the intersection of the two bitmaps, that should have the same size
+    size_t countAnd(const Bitmap &other) const {
+        size_t count = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            count += __builtin_popcountll(words[i] & other.words[i]);
+        }
+        return count;
+    }
+
+    //Calls callback(position) for each set bit in increasing order
+    template <typename Callback>
+    void forEach(Callback callback) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                callback(i * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+private:
+    void clearPadding() {
+        if (bits_count % 64 != 0) {
+            words.back() &= ((uint64_t) 1 << (bits_count % 64)) - 1;
+        }
+    }
+
+    std::vector<uint64_t> words;
+    size_t bits_count;
+};
@@ -9,13 +9,24 @@
 #include <memory>
 #include <algorithm>
 #include <cstdlib>
+#include <tuple>
+#include <unordered_map>
 
 #include "triplestore.h"
+#include "cardinality_statements.h"
+#include "command_line.h"
+#include "ntriples.h"
+#include "snapshot.h"
+#include "top_k.h"
+#include "join.h"
+#include "bitmap.h"
+#include "parallel_for.h"
 
 const size_t MIN_STANDARD_CONFIDENCE_X100 = 1;
 const size_t MAX_STANDARD_CONFIDENCE = 100;
 const size_t MIN_SUPPORT = 200;
 const size_t CARDINALITIES_UPPER_BOUND = 5;
+const uint32_t UNBOUNDED = std::numeric_limits<uint32_t>::max();
 
 struct Boundary {
     size_t count;
@@ -87,132 +98,180 @@ struct Rule {
 };
 
 
+struct BetterConfidence {
+    inline bool operator()(const Rule &a, const Rule &b) const {
+        return a.confidence > b.confidence;
+    }
+};
+
+//The best rules by decreasing confidence, the first generated being kept on ties
+typedef TopK<Rule, BetterConfidence> TopRules;
+
 class CardinalitiesStore {
 public:
-    size_t getUpperBound(const TripleStore::node_id s, const TripleStore::node_id p) {
-        auto sp_bound = map_get_value(at_most_bounds_for_property_subject[p], s, std::numeric_limits<std::size_t>::max());
-        return map_get_value(at_most_bounds_for_property, p, sp_bound);
+    CardinalitiesStore(std::shared_ptr<TripleStore> triple_store) : triple_store(triple_store) {
+        addDefaultBounds();
+    }
+
+    inline size_t getUpperBound(const TripleStore::node_id s, const TripleStore::node_id p) const {
+        const auto bound = upper_bounds[bounds_for_property[p]].get(s);
+        return bound == UNBOUNDED ? std::numeric_limits<std::size_t>::max() : bound;
     }
 
-    size_t getLowerBound(const TripleStore::node_id s, const TripleStore::node_id p) {
-        size_t default_value = getActualCount(s, p);
-        auto sp_bound = map_get_value(at_least_bounds_for_property_subject[p], s, default_value);
-        return map_get_value(at_least_bounds_for_property, p, sp_bound);
+    inline size_t getLowerBound(const TripleStore::node_id s, const TripleStore::node_id p) const {
+        return lower_bounds[bounds_for_property[p]].get(s);
     }
 
-    size_t getActualCount(const TripleStore::node_id s, const TripleStore::node_id p) {
-        if (!map_has_key(pso[p], s)) {
-            return 0;
+    inline size_t getActualCount(const TripleStore::node_id s, const TripleStore::node_id p) const {
+        return triple_store->getRelation(p).getObjects(s).size();
+    }
+
+    //Should be called once the triples are loaded in the triple store
+    void addStatements(const MappableVector<CardinalityStatement> &statements) {
+        for (const auto p : getProperties()) {
+            for (const auto so : triple_store->getRelation(p)) {
+                individuals.insert(so.subject);
+                individuals.insert(so.objects.begin(), so.objects.end());
+            }
         }
-        return pso[p][s].size();
+        for (const auto &statement : statements) {
+            addCardinalityStatement(statement);
+        }
+        addBoundsFromStatements();
+        freezeBounds();
     }
 
-    void loadFile(const std::string &file_name) {
-        //TODO: bad hack
-        at_least_bounds_for_property[getIdForNode("P22")] = 1;
-        at_least_bounds_for_property[getIdForNode("P25")] = 1;
-        at_most_bounds_for_property[getIdForNode("P22")] = 1;
-        at_most_bounds_for_property[getIdForNode("P25")] = 1;
-        possibles_at_most_bounds[getIdForNode("P22")].insert(1);
-        possibles_at_least_bounds[getIdForNode("P22")].insert(1);
-        possibles_at_most_bounds[getIdForNode("P25")].insert(1);
-        possibles_at_least_bounds[getIdForNode("P25")].insert(1);
-
-        std::ifstream input_stream(file_name);
-        if (!input_stream.is_open()) {
-            throw std::runtime_error(file_name + " is not readable.");
-        }
-        size_t i = 0;
-        std::string s, p, o;
-        std::string line;
-        while (std::getline(input_stream, line)) {
-            std::istringstream line_stream(line);
-            if (!(line_stream >> s >> p >> o)) {
-                continue;
+    inline std::experimental::string_view getNodeForId(const TripleStore::node_id id) const {
+        return triple_store->getNodeForId(id);
+    }
+
+    inline TripleStore::node_id getIdForNode(const std::experimental::string_view node) {
+        return triple_store->getIdForNode(node);
+    }
+
+    inline const std::set<TripleStore::node_id> &getProperties() const {
+        return triple_store->getProperties();
+    }
+
+    inline const std::shared_ptr<TripleStore> &getTripleStore() const {
+        return triple_store;
+    }
+
+    std::map<TripleStore::node_id, std::set<size_t>> possibles_at_least_bounds;
+    std::map<TripleStore::node_id, std::set<size_t>> possibles_at_most_bounds;
+    std::set<TripleStore::node_id> individuals;
+
+private:
+    //Bounds of a property for some subjects, the other nodes having the default bound.
+    //The bounds are stored in an array indexed by node id if the subjects are a large share of the nodes,
+    //else in an open addressing hash table with linear probing
+    class PropertyBounds {
+    public:
+        typedef std::vector<std::pair<TripleStore::node_id, uint32_t>> SubjectBounds;
+
+        PropertyBounds(const uint32_t default_bound) : default_bound(default_bound) {}
+
+        PropertyBounds(const SubjectBounds &subject_bounds, const uint32_t default_bound, const size_t nodes_count) :
+                default_bound(default_bound) {
+            if (subject_bounds.empty()) {
+                return;
             }
-            if (p == "hasExactCardinality" || p == "hasAtLeastCardinality" || p == "hasAtMostCardinality") {
-                std::string subject;
-                size_t j = 0;
-                for (; j < s.size() && s[j] != '|'; j++) {
-                    subject.push_back(s[j]);
+            if (DENSE_NODES_PER_SUBJECT * subject_bounds.size() >= nodes_count) {
+                dense_values.assign(nodes_count, default_bound);
+                for (const auto &subject_bound : subject_bounds) {
+                    dense_values[subject_bound.first] = subject_bound.second;
                 }
-                std::string predicate = s.substr(j + 1, std::string::npos);
-                /*if (!set_contains(allowed_properties, predicate)) { //TODO not well parsed
-                    continue;
-                }*/
-                auto p_ = getIdForNode(predicate);
-                auto s_ = getIdForNode(subject);
-
-                if(!set_contains(properties, p_)) { //We do not get cardinalities on properties we know nothing
-                    continue;
+                return;
+            }
+            //At most half of the slots are used
+            size_t bits = 2;
+            while (((size_t) 1 << bits) < 2 * subject_bounds.size()) {
+                bits++;
+            }
+            shift = 32 - bits;
+            keys.assign((size_t) 1 << bits, (TripleStore::node_id) EMPTY_KEY);
+            values.resize(keys.size());
+            for (const auto &subject_bound : subject_bounds) {
+                size_t slot = getSlot(subject_bound.first);
+                while (keys[slot] != EMPTY_KEY && keys[slot] != subject_bound.first) {
+                    slot = (slot + 1) & (keys.size() - 1);
                 }
+                keys[slot] = subject_bound.first;
+                values[slot] = subject_bound.second;
+            }
+        }
 
-                size_t value = strtoul(o.c_str(), nullptr, 10);
-                if (p == "hasExactCardinality") {
-                    addAtLeastCardinality(s_, p_, value);
-                    addAtMostCardinality(s_, p_, value);
-                } else if (p == "hasAtLeastCardinality") {
-                    addAtLeastCardinality(s_, p_, value);
-                } else if (p == "hasAtMostCardinality") {
-                    addAtMostCardinality(s_, p_, value);
+        inline uint32_t get(const TripleStore::node_id s) const {
+            if (!dense_values.empty()) {
+                return dense_values[s];
+            }
+            if (keys.empty()) {
+                return default_bound;
+            }
+            for (size_t slot = getSlot(s);; slot = (slot + 1) & (keys.size() - 1)) {
+                if (keys[slot] == s) {
+                    return values[slot];
                 }
-                individuals.insert(s_);
-                properties.insert(p_);
-            } else if (p == "http://www.w3.org/1999/02/22-rdf-syntax-ns#type") {
-                if (o == "http://www.w3.org/2002/07/owl#FunctionalProperty") {
-                    auto p_ = getIdForNode(s);
-                    if(set_contains(properties, p_)) { //We do not get cardinalities on properties we know nothing
-                        at_most_bounds_for_property[p_] = 1;
-                        possibles_at_most_bounds[p_].insert(1);
-                        possibles_at_least_bounds[p_].insert(1);
-                    }
+                if (keys[slot] == EMPTY_KEY) {
+                    return default_bound;
                 }
-            } else {
-                const auto s_ = getIdForNode(s);
-                const auto p_ = getIdForNode(p);
-                const auto o_ = getIdForNode(o);
-
-                pso[p_][s_].insert(o_);
-                pos[p_][o_].insert(s_);
-                individuals.insert(s_);
-                properties.insert(p_);
-                individuals.insert(o_);
-            }
-            i++;
-            if (i % 100000 == 0) {
-                std::cout << '*' << std::flush;
             }
         }
-        std::cout << std::endl;
-        input_stream.close();
 
-        addBoundsFromStatements();
-    }
+    private:
+        //An array costs 4 bytes per node and the table at most 32 bytes per subject
+        static const size_t DENSE_NODES_PER_SUBJECT = 8;
+        static const TripleStore::node_id EMPTY_KEY = std::numeric_limits<TripleStore::node_id>::max();
+
+        inline size_t getSlot(const TripleStore::node_id s) const {
+            return (uint32_t) (s * 2654435761u) >> shift; //Fibonacci hashing
+        }
 
-    inline const std::string &getNodeForId(const TripleStore::node_id id) {
-        return nodes[id];
+        uint32_t default_bound;
+        std::vector<uint32_t> dense_values;
+        std::vector<TripleStore::node_id> keys;
+        std::vector<uint32_t> values;
+        unsigned shift = 32;
+    };
+
+    void addDefaultBounds() {
+        //TODO: bad hack
+        for (const auto property_name : DEFAULT_BOUNDED_PROPERTIES) {
+            const auto property = getIdForNode(property_name);
+            at_least_bounds_for_property[property] = 1;
+            at_most_bounds_for_property[property] = 1;
+            possibles_at_most_bounds[property].insert(1);
+            possibles_at_least_bounds[property].insert(1);
+        }
     }
 
-    TripleStore::node_id getIdForNode(const std::string &node) {
-        if (node[0] == '<' && node[node.size() - 1] == '>') {
-            return getIdForNode(node.substr(1, node.size() - 2));
+    void addCardinalityStatement(const CardinalityStatement &statement) {
+        const auto s = statement.subject;
+        const auto p = statement.property;
+        if (!set_contains(getProperties(), p)) { //We do not get cardinalities on properties we know nothing
+            return;
         }
 
-        if (!map_has_key(id_for_nodes, node)) {
-            nodes.push_back(node);
-            id_for_nodes[node] = nodes.size() - 1;
+        switch (statement.kind) {
+            case CardinalityStatement::EXACT:
+                addAtLeastCardinality(s, p, statement.value);
+                addAtMostCardinality(s, p, statement.value);
+                break;
+            case CardinalityStatement::AT_LEAST:
+                addAtLeastCardinality(s, p, statement.value);
+                break;
+            case CardinalityStatement::AT_MOST:
+                addAtMostCardinality(s, p, statement.value);
+                break;
+            case CardinalityStatement::FUNCTIONAL_PROPERTY:
+                at_most_bounds_for_property[p] = 1;
+                possibles_at_most_bounds[p].insert(1);
+                possibles_at_least_bounds[p].insert(1);
+                return;
         }
-        return id_for_nodes[node];
+        individuals.insert(s);
     }
 
-    std::map<TripleStore::node_id, std::map<TripleStore::node_id, std::set<TripleStore::node_id>>> pso;
-    std::map<TripleStore::node_id, std::map<TripleStore::node_id, std::set<TripleStore::node_id>>> pos;
-    std::map<TripleStore::node_id, std::set<size_t>> possibles_at_least_bounds;
-    std::map<TripleStore::node_id, std::set<size_t>> possibles_at_most_bounds;
-    std::set<TripleStore::node_id> individuals;
-    std::set<TripleStore::node_id> properties;
-
-private:
     inline void addAtMostCardinality(TripleStore::node_id s, TripleStore::node_id p, size_t value) {
         at_most_bounds_for_property_subject[p][s] = value;
         if (value <= CARDINALITIES_UPPER_BOUND) {
@@ -231,14 +290,13 @@ private:
 
     void addBoundsFromStatements() {
         //Extra bounds
-        for (const auto p : properties) {
+        for (const auto p : getProperties()) {
             possibles_at_most_bounds[p].insert(0);
         }
 
-        for (const auto &psos : pso) {
-            const auto p = psos.first;
-            for (const auto &sos : psos.second) {
-                size_t objects_number = sos.second.size();
+        for (const auto p : getProperties()) {
+            for (const auto so : triple_store->getRelation(p)) {
+                size_t objects_number = so.objects.size();
                 if (objects_number < CARDINALITIES_UPPER_BOUND) {
                     possibles_at_least_bounds[p].insert(objects_number);
                 }
@@ -246,75 +304,169 @@ private:
         } //TODO*/
     }
 
+    //Folds the property, subject and actual count bounds into lookup tables sized by the data and frees the loading maps
+    void freezeBounds() {
+        const size_t nodes_count = triple_store->getNumberOfEntities();
+        std::set<TripleStore::node_id> bounded_properties = getProperties();
+        for (const auto &property_bound : at_least_bounds_for_property) {
+            bounded_properties.insert(property_bound.first);
+        }
+        for (const auto &property_bound : at_most_bounds_for_property) {
+            bounded_properties.insert(property_bound.first);
+        }
+
+        //The slot 0 is used for properties without triples nor bounds
+        bounds_for_property.assign(nodes_count, 0);
+        lower_bounds.clear();
+        upper_bounds.clear();
+        lower_bounds.emplace_back(0);
+        upper_bounds.emplace_back(UNBOUNDED);
+        for (const auto p : bounded_properties) {
+            bounds_for_property[p] = lower_bounds.size();
+
+            if (map_has_key(at_least_bounds_for_property, p)) {
+                lower_bounds.emplace_back(at_least_bounds_for_property[p]);
+            } else {
+                //The subject statements override the actual counts, both being sorted by subject
+                const auto &subject_statements = at_least_bounds_for_property_subject[p];
+                auto statement = subject_statements.begin();
+                PropertyBounds::SubjectBounds subject_bounds;
+                for (const auto so : triple_store->getRelation(p)) {
+                    for (; statement != subject_statements.end() && statement->first < so.subject; statement++) {
+                        subject_bounds.emplace_back(statement->first, statement->second);
+                    }
+                    if (statement != subject_statements.end() && statement->first == so.subject) {
+                        subject_bounds.emplace_back(statement->first, statement->second);
+                        statement++;
+                    } else {
+                        subject_bounds.emplace_back(so.subject, so.objects.size());
+                    }
+                }
+                for (; statement != subject_statements.end(); statement++) {
+                    subject_bounds.emplace_back(statement->first, statement->second);
+                }
+                lower_bounds.emplace_back(subject_bounds, 0, nodes_count);
+            }
+
+            if (map_has_key(at_most_bounds_for_property, p)) {
+                upper_bounds.emplace_back(at_most_bounds_for_property[p]);
+            } else {
+                const auto &subject_statements = at_most_bounds_for_property_subject[p];
+                upper_bounds.emplace_back(PropertyBounds::SubjectBounds(subject_statements.begin(), subject_statements.end()),
+                                          UNBOUNDED, nodes_count);
+            }
+        }
+
+        at_least_bounds_for_property_subject.clear();
+        at_most_bounds_for_property_subject.clear();
+        at_least_bounds_for_property.clear();
+        at_most_bounds_for_property.clear();
+    }
+
+    std::shared_ptr<TripleStore> triple_store;
+    std::vector<uint32_t> bounds_for_property;
+    std::vector<PropertyBounds> lower_bounds;
+    std::vector<PropertyBounds> upper_bounds;
     std::map<TripleStore::node_id, std::map<TripleStore::node_id, size_t>> at_least_bounds_for_property_subject;
     std::map<TripleStore::node_id, std::map<TripleStore::node_id, size_t>> at_most_bounds_for_property_subject;
     std::map<TripleStore::node_id, size_t> at_least_bounds_for_property;
     std::map<TripleStore::node_id, size_t> at_most_bounds_for_property;
-    std::vector<std::string> nodes;
-    std::map<std::string, TripleStore::node_id> id_for_nodes;
 };
 
-const unsigned int NO_VALUE = std::numeric_limits<unsigned int>::max();
+inline bool matches_boundary(const CardinalitiesStore &store, const TripleStore::node_id value, const Boundary &boundary) {
+    if (boundary.is_upper) {
+        return boundary.count >= store.getUpperBound(value, boundary.property);
+    } else {
+        return boundary.count <= store.getLowerBound(value, boundary.property);
+    }
+}
 
-class QueryTuple { //TODO support variables other than x and y
-public:
-    inline TripleStore::node_id getValue(char variable) const {
-        switch (variable) {
-            case 'x':
-                return x_value;
-            case 'y':
-                return y_value;
-            default:
-                throw std::runtime_error(std::string(1, variable) + " variable name is not supported.");
-        }
-    }
-
-    inline QueryTuple withValue(char variable, TripleStore::node_id value) const {
-        QueryTuple new_tuple = *this;
-        switch (variable) {
-            case 'x':
-                new_tuple.x_value = value;
-                return new_tuple;
-            case 'y':
-                new_tuple.y_value = value;
-                return new_tuple;
-            default:
-                throw std::runtime_error(std::string(1, variable) + " variable name is not supported.");
-        }
-    }
-
-    inline QueryTuple withoutValue(char variable) const {
-        if(isBinded(variable)) {
-            return this->withValue(variable, NO_VALUE);
-        } else {
-            return *this;
-        }
+inline bool contradicts_boundary(const CardinalitiesStore &store, const TripleStore::node_id value, const Boundary &boundary) {
+    if (boundary.is_upper) {
+        return boundary.count < store.getLowerBound(value, boundary.property);
+    } else {
+        return boundary.count > store.getUpperBound(value, boundary.property);
     }
+}
 
-    inline bool isBinded(char variable) const {
-        switch (variable) {
-            case 'x':
-                return x_value != NO_VALUE;
-            case 'y':
-                return y_value != NO_VALUE;
-            default:
-                return false;
-        }
+//Rule body with its variables resolved to query slots, x being the slot 0
+struct CompiledBody {
+    std::vector<QueryAtom> atoms;
+    std::vector<std::vector<Boundary>> boundaries_by_variable;
+    size_t variables_count;
+};
+
+CompiledBody compile_body(const Rule &rule) {
+    if (rule.head.subject != 'x') {
+        throw std::runtime_error(std::string(1, rule.head.subject) + " head variable is not supported.");
     }
+    std::vector<char> variables = {'x'};
+    const auto get_variable_id = [&variables](const char variable) {
+        const auto iter = std::find(variables.begin(), variables.end(), variable);
+        if (iter != variables.end()) {
+            return (variable_id) (iter - variables.begin());
+        }
+        if (variables.size() == MAX_QUERY_VARIABLES) {
+            throw std::runtime_error("too many variables in the rule body.");
+        }
+        variables.push_back(variable);
+        return (variable_id) (variables.size() - 1);
+    };
 
-    inline bool operator<(const QueryTuple &other) const {
-        return x_value < other.x_value || (x_value == other.x_value && y_value < other.y_value);
+    CompiledBody body;
+    for (const auto &triple : rule.body_triples) {
+        const auto subject = get_variable_id(triple.subject);
+        const auto object = get_variable_id(triple.object);
+        body.atoms.push_back({triple.property, subject, object});
     }
+    body.variables_count = variables.size();
+    body.boundaries_by_variable.resize(variables.size());
+    for (const auto &boundary : rule.body_boundaries) {
+        const auto iter = std::find(variables.begin(), variables.end(), boundary.subject);
+        if (iter == variables.end()) {
+            throw std::runtime_error(std::string(1, boundary.subject) + " boundary variable is not in the rule body.");
+        }
+        body.boundaries_by_variable[iter - variables.begin()].push_back(boundary);
+    }
+    return body;
+}
 
-    inline bool operator==(const QueryTuple &other) const {
-        return x_value == other.x_value && y_value == other.y_value;
+//Accepts the individuals whose position is set in the bitmap
+class BitmapFilter {
+public:
+    BitmapFilter(const Bitmap &bitmap, const std::vector<uint32_t> &positions) : bitmap(bitmap), positions(positions) {}
+
+    inline bool operator()(const TripleStore::node_id value) const {
+        return bitmap.test(positions[value]);
     }
 
 private:
-    TripleStore::node_id x_value = NO_VALUE;
-    TripleStore::node_id y_value = NO_VALUE;
+    const Bitmap &bitmap;
+    const std::vector<uint32_t> &positions;
 };
 
+struct AcceptAll {
+    inline bool operator()(const TripleStore::node_id) const {
+        return true;
+    }
+};
+
+//Body x(p)y where the relation maps x to y: calls callback(x) in increasing order for the x matching x_filter
+//with an y matching y_filter
+template <typename XFilter, typename YFilter, typename Callback>
+void join_single_atom(const Relation &x_to_y, const XFilter &x_filter, const YFilter &y_filter, Callback callback) {
+    for (const auto xy : x_to_y) {
+        if (!x_filter(xy.subject)) {
+            continue;
+        }
+        for (const auto y : xy.objects) {
+            if (y_filter(y)) {
+                callback(xy.subject);
+                break;
+            }
+        }
+    }
+}
 
 void addBoundaryToStream(const SubjectPredicateBoundary boundary, std::ostream &ostream,
                          std::shared_ptr<CardinalitiesStore> triples) {
@@ -331,7 +483,7 @@ void addRuleToStream(const Rule &rule, std::ostream &ostream, std::shared_ptr<Ca
     addBoundaryToStream(rule.head, ostream, triples);
     ostream << " <-";
     for (const auto &triple : rule.body_triples) {
-        ostream << ' ' + triples->getNodeForId(triple.property) << '(' << triple.subject << ", " << triple.object
+        ostream << ' ' << triples->getNodeForId(triple.property) << '(' << triple.subject << ", " << triple.object
                 << ')';
     }
     for (const auto &boundary : rule.body_boundaries) {
@@ -341,22 +493,126 @@ void addRuleToStream(const Rule &rule, std::ostream &ostream, std::shared_ptr<Ca
 
 }
 
+//Lower or upper bounds with their confidence inferred for the (individual, property) pairs.
+//Only the bounds changed by the rules are stored, the other ones of the known properties being the ones of the
+//cardinalities store with the maximal confidence
+class InferredBounds {
+public:
+    typedef std::pair<size_t, size_t> BoundWithConfidence;
+
+    InferredBounds(std::shared_ptr<CardinalitiesStore> store, const bool is_upper) : store(store), is_upper(is_upper) {}
+
+    BoundWithConfidence get(const TripleStore::node_id x, const TripleStore::node_id p) const {
+        const auto property_overrides = overrides.find(p);
+        if (property_overrides != overrides.end()) {
+            const auto bound = property_overrides->second.find(x);
+            if (bound != property_overrides->second.end()) {
+                return bound->second;
+            }
+        }
+        return getDefault(x, p);
+    }
+
+    inline void set(const TripleStore::node_id x, const TripleStore::node_id p, const size_t bound, const size_t confidence) {
+        overrides[p][x] = std::make_pair(bound, confidence);
+    }
+
+    //Calls callback(x, p, bound) for all the individual and known property pairs, then for the other changed pairs
+    template <typename Callback>
+    void forEach(Callback callback) const {
+        for (const auto x : store->individuals) {
+            for (const auto p : store->getProperties()) {
+                callback(x, p, get(x, p));
+            }
+        }
+        for (const auto &property_overrides : overrides) {
+            if (!set_contains(store->getProperties(), property_overrides.first)) {
+                for (const auto &bound : property_overrides.second) {
+                    callback(bound.first, property_overrides.first, bound.second);
+                }
+            }
+        }
+    }
+
+    //Calls callback(x, p) for each pair whose bound was changed by the rules
+    template <typename Callback>
+    void forEachChanged(Callback callback) const {
+        for (const auto &property_overrides : overrides) {
+            for (const auto &bound : property_overrides.second) {
+                callback(bound.first, property_overrides.first);
+            }
+        }
+    }
+
+    //For each of the sorted minimal confidences, the number of the pairs of forEach whose bound has at least this confidence
+    std::vector<size_t> countByMinConfidence(const std::vector<size_t> &min_confidences) const {
+        //The pairs of the known properties that are not changed keep the maximal confidence
+        size_t default_count = store->individuals.size() * store->getProperties().size();
+        //The number of changed bounds by number of minimal confidences they reach
+        std::vector<size_t> reached(min_confidences.size() + 1, 0);
+        for (const auto &property_overrides : overrides) {
+            const bool is_known_property = set_contains(store->getProperties(), property_overrides.first);
+            for (const auto &bound : property_overrides.second) {
+                if (is_known_property) {
+                    default_count--;
+                }
+                reached[std::upper_bound(min_confidences.begin(), min_confidences.end(), bound.second.second) -
+                        min_confidences.begin()]++;
+            }
+        }
+        //The bounds reaching more than i minimal confidences reach the i-th one
+        std::vector<size_t> counts(min_confidences.size());
+        size_t reaching_count = 0;
+        for (size_t i = min_confidences.size(); i-- > 0;) {
+            reaching_count += reached[i + 1];
+            counts[i] = reaching_count + (min_confidences[i] <= MAX_STANDARD_CONFIDENCE ? default_count : 0);
+        }
+        return counts;
+    }
+
+private:
+    BoundWithConfidence getDefault(const TripleStore::node_id x, const TripleStore::node_id p) const {
+        if (!set_contains(store->getProperties(), p)) {
+            return std::make_pair(is_upper ? std::numeric_limits<std::size_t>::max() : 0, MAX_STANDARD_CONFIDENCE);
+        }
+        return std::make_pair(is_upper ? store->getUpperBound(x, p) : store->getLowerBound(x, p), MAX_STANDARD_CONFIDENCE);
+    }
+
+    std::shared_ptr<CardinalitiesStore> store;
+    bool is_upper;
+    //property -> individual -> bound changed by the rules
+    std::map<TripleStore::node_id, std::unordered_map<TripleStore::node_id, BoundWithConfidence>> overrides;
+};
+
 class CardinalityRuleMining {
 public:
     typedef std::map<std::pair<TripleStore::node_id,TripleStore::node_id>,std::pair<size_t,size_t>> map_id_id_size_t_size_t;
 
-    CardinalityRuleMining(std::shared_ptr<CardinalitiesStore> triple_store)
-            : cardinalityStore(triple_store), tuplesForIndividuals(std::vector<QueryTuple>()) {
-        QueryTuple empty_tuple;
-        for (const auto x : triple_store->individuals) {
-            tuplesForIndividuals.push_back(empty_tuple.withValue('x', x));
+    CardinalityRuleMining(std::shared_ptr<CardinalitiesStore> triple_store) :
+            cardinalityStore(triple_store), individuals(triple_store->individuals.begin(), triple_store->individuals.end()),
+            body_x_values(individuals.size()), x_candidates(individuals.size()), y_candidates(individuals.size()) {
+        individual_positions.assign(triple_store->getTripleStore()->getNumberOfEntities(), 0);
+        for (size_t i = 0; i < individuals.size(); i++) {
+            individual_positions[individuals[i]] = i;
+        }
+
+        //The individuals matching and contradicting each possible boundary
+        for (const auto &property_bounds : triple_store->possibles_at_least_bounds) {
+            for (const auto bound : property_bounds.second) {
+                addBoundaryBitmaps(Boundary(property_bounds.first, bound, false));
+            }
+        }
+        for (const auto &property_bounds : triple_store->possibles_at_most_bounds) {
+            for (const auto bound : property_bounds.second) {
+                addBoundaryBitmaps(Boundary(property_bounds.first, bound, true));
+            }
         }
     }
 
-    std::vector<Rule> doMining(size_t output_k_rules) {
+    std::vector<Rule> doMining(size_t output_k_rules, size_t threads_count = 1) {
         std::cout << "starting rule mining" << std::endl;
         std::cout << "doing mining on properties: ";
-        for(const auto p : cardinalityStore->properties) {
+        for(const auto p : cardinalityStore->getProperties()) {
             std::cout << cardinalityStore->getNodeForId(p) << ' ';
         }
         std::cout << std::endl;
@@ -388,156 +644,107 @@ public:
 
         //Rule mining
         std::cout << "doing rule mining" << std::endl;
-        std::vector<Rule> rules;
+        TopRules rules(output_k_rules);
+
+        //The bindings of each refined body are computed from the ones of its parent
+        BodyBindings head_bindings;
+        head_bindings.x_values = Bitmap(individuals.size(), true);
 
         //All possible heads
         std::vector<Rule> head_rules;
         for (const auto &boundary_list : possible_boundaries_with_priority_list) {
             for (const auto &boundary : boundary_list) {
                 Rule rule(boundary);
-                addEvaluations(rule);
+                addEvaluations(rule, head_bindings);
                 if (rule.support >= MIN_SUPPORT) {
                     head_rules.push_back(rule);
                     if (rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
-                        rules.push_back(rule);
+                        rules.push(rule);
                     }
                 }
             }
         }
 
-        //Optionally a C_x
+        //The head rules are expanded in parallel, the results are then merged in head order
+        std::vector<std::vector<Rule>> rules_with_x_bounds_by_head(head_rules.size());
+        std::vector<std::vector<Rule>> rules_with_y_bounds_by_head(head_rules.size());
+        std::vector<std::vector<Rule>> merged_rules_by_head(head_rules.size());
+        parallel_for(head_rules.size(), std::max((size_t) 1, threads_count), [&](const size_t head, const size_t) {
+            addRulesWithXBounds(head_rules[head], head_bindings, possible_boundaries_with_priority_list,
+                                rules_with_x_bounds_by_head[head]);
+            addRulesWithYBounds(head_rules[head], head_bindings, possible_boundaries_with_priority_list,
+                                rules_with_y_bounds_by_head[head], rules_with_x_bounds_by_head[head],
+                                merged_rules_by_head[head]);
+        });
         std::vector<Rule> rules_with_x_bounds;
-        for (const auto &rule : head_rules) {
-            //We add a C_N(X) with a new property (to avoid trivial rules C_N(X) <= k -> C_N(X) <= k' with k' >= k
-            for (const auto &boundary_list : possible_boundaries_with_priority_list) {
-                Rule parent_rule = rule;
-                for (const auto &boundary : boundary_list) {
-                    if (boundary.property != rule.head.property) {
-                        Rule new_rule = rule;
-                        new_rule.body_boundaries.push_back(boundary);
-                        addEvaluations(new_rule);
-                        if (new_rule.support >= MIN_SUPPORT && parent_rule.confidence < new_rule.confidence) {
-                            rules_with_x_bounds.push_back(new_rule);
-                            parent_rule = new_rule;
-                            if (new_rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
-                                rules.push_back(new_rule);
-                            }
-                        }
-                    }
-                }
-            }
+        for (const auto &head_rules_with_x_bounds : rules_with_x_bounds_by_head) {
+            rules_with_x_bounds.insert(rules_with_x_bounds.end(), head_rules_with_x_bounds.begin(), head_rules_with_x_bounds.end());
         }
-
-        //Optionally a P(X,Y) and a C_Y
         std::vector<Rule> rules_with_y_bounds;
-        for (const auto &rule : head_rules) {
-            for (const auto property : cardinalityStore->properties) {
-                std::vector<Rule> new_rules(2, rule); //+p(x,y) and p(y,x)
-                new_rules[0].body_triples.push_back(TriplePattern('x', property, 'y'));
-                new_rules[1].body_triples.push_back(TriplePattern('y', property, 'x'));
-
-                for (Rule &new_rule : new_rules) {
-                    addEvaluations(new_rule);
-                    Rule main_parent_rule = rule;
-                    if (new_rule.support >= MIN_SUPPORT && rule.confidence < new_rule.confidence) {
-                        rules_with_y_bounds.push_back(new_rule);
-                        main_parent_rule = new_rule;
-                        if (new_rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
-                            rules.push_back(new_rule);
-                        }
-                    }
-
-                    //We add a C_M(Y)
-                    for (const auto &boundary_list : possible_boundaries_with_priority_list) {
-                        Rule parent_rule = main_parent_rule;
-                        for (const auto &boundary : boundary_list) {
-                            Rule new_rule2 = new_rule;
-                            new_rule2.body_boundaries.push_back(
-                                    SubjectPredicateBoundary('y', boundary.property, boundary.count,
-                                                             boundary.is_upper));
-                            addEvaluations(new_rule2);
-                            if (new_rule2.support >= MIN_SUPPORT && parent_rule.confidence < new_rule2.confidence) {
-                                rules_with_y_bounds.push_back(new_rule2);
-                                parent_rule = new_rule2;
-                                if (new_rule2.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
-                                    rules.push_back(new_rule2);
-                                }
-                            }
-                        }
-                    }
-                }
+        for (const auto &head_rules_with_y_bounds : rules_with_y_bounds_by_head) {
+            rules_with_y_bounds.insert(rules_with_y_bounds.end(), head_rules_with_y_bounds.begin(), head_rules_with_y_bounds.end());
+        }
+        for (const auto &rule : rules_with_x_bounds) {
+            if (rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
+                rules.push(rule);
+            }
+        }
+        for (const auto &rule : rules_with_y_bounds) {
+            if (rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
+                rules.push(rule);
             }
         }
 
-        //We merges rules with X and Y bounds together
+        //The rules with X and Y bounds merged together
         size_t rules_count = head_rules.size() + rules_with_x_bounds.size() + rules_with_y_bounds.size();
-        for (const auto &x_rule : rules_with_x_bounds) {
-            for (const auto &y_rule : rules_with_y_bounds) {
-                if (x_rule.head == y_rule.head) {
-                    Rule new_rule = y_rule.mergedWith(x_rule);
-                    if (x_rule.confidence < new_rule.confidence && y_rule.confidence < new_rule.confidence) {
-                        if (new_rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
-                            rules.push_back(new_rule);
-                        }
-                    }
-                    rules_count++;
+        for (size_t head = 0; head < head_rules.size(); head++) {
+            rules_count += rules_with_x_bounds_by_head[head].size() * rules_with_y_bounds_by_head[head].size();
+            for (const auto &rule : merged_rules_by_head[head]) {
+                if (rule.confidence >= MIN_STANDARD_CONFIDENCE_X100) {
+                    rules.push(rule);
                 }
             }
         }
 
         std::cout << rules_count << " rules generated" << std::endl;
         std::cout << "sorting rules" << std::endl;
-        std::sort(rules.begin(), rules.end(),
-                  [](const Rule &a, const Rule &b) {
-                      return a.confidence > b.confidence;
-                  });
-
-        size_t limit = std::min(output_k_rules, rules.size());
-        std::vector<Rule> result;
-        for (size_t i = 0; i < limit; i++) {
-            result.push_back(rules[i]);
-        }
-        return result;
+        return rules.sorted();
     }
 
 
-    std::pair<map_id_id_size_t_size_t,map_id_id_size_t_size_t> executeRules(const std::vector<Rule>& rules) {
-        map_id_id_size_t_size_t upper_bounds;
-        map_id_id_size_t_size_t lower_bounds;
-
-        for(const auto p : cardinalityStore->properties) { //TODO:memory greedy
-            for(const auto x : cardinalityStore->individuals) {
-                upper_bounds[std::make_pair(x, p)] = std::make_pair(cardinalityStore->getUpperBound(x, p), MAX_STANDARD_CONFIDENCE);
-                lower_bounds[std::make_pair(x, p)] = std::make_pair(cardinalityStore->getLowerBound(x, p), MAX_STANDARD_CONFIDENCE);
-            }
-        }
+    //Returns the lower and upper bounds. If contradicted_x_by_rule is set, it receives for each rule the x it contradicts
+    std::pair<InferredBounds, InferredBounds> executeRules(const std::vector<Rule>& rules,
+                                                           const bool compare_upper_bound_value = false,
+                                                           std::vector<std::set<TripleStore::node_id>> *contradicted_x_by_rule = nullptr) {
+        InferredBounds upper_bounds(cardinalityStore, true);
+        InferredBounds lower_bounds(cardinalityStore, false);
 
         std::cout << cardinalityStore->individuals.size() << " individuals" << std::endl;
+        if (contradicted_x_by_rule != nullptr) {
+            contradicted_x_by_rule->assign(rules.size(), std::set<TripleStore::node_id>());
+        }
         size_t contradictions_sum = 0;
-        std::pair<size_t,size_t> lower_default = std::make_pair(0, MAX_STANDARD_CONFIDENCE);
-        std::pair<size_t,size_t> upper_default = std::make_pair(std::numeric_limits<std::size_t>::max(), MAX_STANDARD_CONFIDENCE);
-        for(const auto& rule : rules) {
+        for (size_t rule_index = 0; rule_index < rules.size(); rule_index++) {
+            const auto &rule = rules[rule_index];
             size_t added_contradictions = 0;
-            for (const auto& tuple : evaluateRuleBody(rule)) {
-                auto x = tuple.getValue(rule.head.subject);
+            evaluateRuleBody(compile_body(rule), body_x_values);
+            body_x_values.forEach([&](const size_t position) {
+                auto x = individuals[position];
                 auto p = rule.head.property;
-                auto x_p = std::make_pair(x, p);
-                const auto& lower_bound = map_get_value(lower_bounds, x_p, lower_default);
-                const auto& upper_bound = map_get_value(upper_bounds, x_p, upper_default);
-                if (rule.head.is_upper) {
-                    if(lower_bound.first > rule.head.count) {
-                        added_contradictions++;
-                    } else if(upper_bound.first > rule.head.count) {
-                        upper_bounds[x_p] = std::make_pair(rule.head.count, rule.confidence);
-                    }
-                } else {
-                    if(upper_bound.second < rule.head.count) {
+                switch (getHeadEffect(rule, lower_bounds.get(x, p), upper_bounds.get(x, p), compare_upper_bound_value)) {
+                    case CONTRADICTS:
                         added_contradictions++;
-                    } else if(lower_bound.first < rule.head.count) {
-                        lower_bounds[x_p] = std::make_pair(rule.head.count, rule.confidence);
-                    }
+                        if (contradicted_x_by_rule != nullptr) {
+                            (*contradicted_x_by_rule)[rule_index].insert(x);
+                        }
+                        break;
+                    case TIGHTENS:
+                        (rule.head.is_upper ? upper_bounds : lower_bounds).set(x, p, rule.head.count, rule.confidence);
+                        break;
+                    case KEEPS:
+                        break;
                 }
-            }
+            });
             contradictions_sum += added_contradictions;
             std::cout << added_contradictions << "\t" << contradictions_sum << "\t" << (float) rule.confidence / MAX_STANDARD_CONFIDENCE << "\t";
             addRuleToStream(rule, std::cout, cardinalityStore);
@@ -547,169 +754,617 @@ public:
         return std::make_pair(lower_bounds, upper_bounds);
     }
 
-    std::map<std::pair<TripleStore::node_id,TripleStore::node_id>,std::pair<size_t,size_t>> buildExactCardinalities(std::pair<map_id_id_size_t_size_t,map_id_id_size_t_size_t>& cardinalities) {
-        std::map<std::pair<TripleStore::node_id,TripleStore::node_id>,std::pair<size_t,size_t>> exact_cardinalities;
-        std::pair<size_t,size_t> upper_default = std::make_pair(std::numeric_limits<std::size_t>::max(), MAX_STANDARD_CONFIDENCE);
-        for(const auto& lower_bound_per_x_p : cardinalities.first) {
-            const auto& x_p = lower_bound_per_x_p.first;
-            const auto& lower_bound = lower_bound_per_x_p.second;
-            const auto& upper_bound =  map_get_value(cardinalities.second, x_p, upper_default);
-            if(lower_bound.first == upper_bound.first) {
-                exact_cardinalities[x_p] = std::make_pair(lower_bound.first, std::min(lower_bound.second, upper_bound.second));
+    //Applies the rules until no bound changes. The bodies are evaluated against the bounds inferred so far:
+    //the first iteration is executeRules, each following one only re-checks the x whose body could match
+    //because of the bounds tightened by the previous one. The rules are executed in parallel by head property,
+    //each iteration reading the bounds of the previous one.
+    //Unlike the once execution, the lower bound heads are checked against the upper bound value, so that the
+    //inferred lower bounds never exceed the upper ones and are not matched by the next iterations
+    std::pair<InferredBounds, InferredBounds> executeRulesToFixpoint(const std::vector<Rule>& rules, const size_t threads_count) {
+        //The contradictions are counted once per rule and x, a contradicted x staying contradicted as the bounds tighten
+        std::vector<std::set<TripleStore::node_id>> contradicted_x_by_rule;
+        auto bounds = executeRules(rules, true, &contradicted_x_by_rule);
+        auto &lower_bounds = bounds.first;
+        auto &upper_bounds = bounds.second;
+
+        //The rules of each head property, in confidence order
+        std::map<TripleStore::node_id, std::vector<size_t>> rules_by_head_property;
+        std::vector<CompiledBody> bodies;
+        for (size_t i = 0; i < rules.size(); i++) {
+            rules_by_head_property[rules[i].head.property].push_back(i);
+            bodies.push_back(compile_body(rules[i]));
+            if (bodies.back().atoms.size() > 1 || bodies.back().variables_count > 2) {
+                throw std::runtime_error("the fixpoint execution only supports bodies with at most one triple pattern.");
             }
         }
+        std::vector<std::pair<TripleStore::node_id, std::vector<size_t>>> rule_groups(rules_by_head_property.begin(),
+                                                                                      rules_by_head_property.end());
+
+        BoundsDelta delta;
+        lower_bounds.forEachChanged([&](const TripleStore::node_id x, const TripleStore::node_id p) {
+            delta.lower[p].push_back(x);
+        });
+        upper_bounds.forEachChanged([&](const TripleStore::node_id x, const TripleStore::node_id p) {
+            delta.upper[p].push_back(x);
+        });
+        checkConsistency(delta, bounds);
+
+        for (size_t iteration = 1; !delta.empty(); iteration++) {
+            delta.sort();
+            std::vector<GroupChanges> changes(rule_groups.size());
+            parallel_for(rule_groups.size(), std::max((size_t) 1, threads_count), [&](const size_t group, const size_t) {
+                auto &group_changes = changes[group];
+                for (const auto rule_index : rule_groups[group].second) {
+                    const auto &rule = rules[rule_index];
+                    for (const auto x : getDeltaCandidates(bodies[rule_index], delta)) {
+                        if (!matchesBody(bodies[rule_index], x, bounds)) {
+                            continue;
+                        }
+                        const auto p = rule.head.property;
+                        auto &head_changes = rule.head.is_upper ? group_changes.upper : group_changes.lower;
+                        const auto lower_bound = group_changes.lower.count(x) ? group_changes.lower[x] : lower_bounds.get(x, p);
+                        const auto upper_bound = group_changes.upper.count(x) ? group_changes.upper[x] : upper_bounds.get(x, p);
+                        switch (getHeadEffect(rule, lower_bound, upper_bound, true)) {
+                            case CONTRADICTS:
+                                if (contradicted_x_by_rule[rule_index].insert(x).second) {
+                                    group_changes.contradictions++;
+                                }
+                                break;
+                            case TIGHTENS:
+                                head_changes[x] = std::make_pair(rule.head.count, rule.confidence);
+                                break;
+                            case KEEPS:
+                                break;
+                        }
+                    }
+                }
+            });
+
+            //The changes become the delta of the next iteration
+            delta = BoundsDelta();
+            size_t changes_count = 0;
+            size_t contradictions_count = 0;
+            for (size_t group = 0; group < rule_groups.size(); group++) {
+                const auto p = rule_groups[group].first;
+                for (const auto &change : changes[group].lower) {
+                    lower_bounds.set(change.first, p, change.second.first, change.second.second);
+                    delta.lower[p].push_back(change.first);
+                }
+                for (const auto &change : changes[group].upper) {
+                    upper_bounds.set(change.first, p, change.second.first, change.second.second);
+                    delta.upper[p].push_back(change.first);
+                }
+                changes_count += changes[group].lower.size() + changes[group].upper.size();
+                contradictions_count += changes[group].contradictions;
+            }
+            checkConsistency(delta, bounds);
+            std::cout << "fixpoint iteration " << iteration << ": " << changes_count << " bounds tightened, "
+                      << contradictions_count << " new contradictions" << std::endl;
+        }
+        return bounds;
+    }
+
+    map_id_id_size_t_size_t buildExactCardinalities(const std::pair<InferredBounds, InferredBounds>& cardinalities) {
+        map_id_id_size_t_size_t exact_cardinalities;
+        cardinalities.first.forEach([&](const TripleStore::node_id x, const TripleStore::node_id p,
+                                        const InferredBounds::BoundWithConfidence &lower_bound) {
+            const auto upper_bound = cardinalities.second.get(x, p);
+            if(lower_bound.first == upper_bound.first) {
+                exact_cardinalities[std::make_pair(x, p)] = std::make_pair(lower_bound.first, std::min(lower_bound.second, upper_bound.second));
+            }
+        });
         return exact_cardinalities;
     };
 
 private:
-    void addEvaluations(Rule &rule) {
-        //We run the body to get all matching tuples
-        std::set<QueryTuple> body_tuples;
-        QueryTuple empty_tuple;
-        std::vector<QueryTuple> body_query_tuples = evaluateRuleBody(rule);
-        for (const auto &tuple : body_query_tuples) {
-            if (tuple.isBinded('x')) {
-                body_tuples.insert(tuple.withoutValue('y')); //TODO: support other variables
-            } else {
-                std::cout << "no x but with triple patterns" << std::endl;
-                body_tuples.insert(tuplesForIndividuals.begin(), tuplesForIndividuals.end());
-                break;
+    enum HeadEffect {
+        KEEPS, TIGHTENS, CONTRADICTS
+    };
+
+    //Effect of the rule head on the current bounds of a matching x.
+    //The once execution compares the lower bound heads with the confidence of the upper bound to keep its output
+    //unchanged, compare_upper_bound_value compares them with the upper bound itself
+    static HeadEffect getHeadEffect(const Rule &rule, const InferredBounds::BoundWithConfidence &lower_bound,
+                                    const InferredBounds::BoundWithConfidence &upper_bound,
+                                    const bool compare_upper_bound_value) {
+        if (rule.head.is_upper) {
+            if(lower_bound.first > rule.head.count) {
+                return CONTRADICTS;
+            } else if(upper_bound.first > rule.head.count) {
+                return TIGHTENS;
+            }
+        } else {
+            if((compare_upper_bound_value ? upper_bound.first : upper_bound.second) < rule.head.count) {
+                return CONTRADICTS;
+            } else if(lower_bound.first < rule.head.count) {
+                return TIGHTENS;
             }
         }
+        return KEEPS;
+    }
 
-        size_t body_support = body_tuples.size();
-        rule.support = 0;
-        rule.contradictions = 0;
-        rule.confidence = MAX_STANDARD_CONFIDENCE;
-        rule.contradictions_ratio = 0;
-        for (const auto &tuple : body_tuples) {
-            if (matchesBoundary(tuple, rule.head)) {
-                rule.support++;
+    //The x whose lower or upper bound of each property has been tightened by the last fixpoint iteration, sorted
+    struct BoundsDelta {
+        std::map<TripleStore::node_id, std::vector<TripleStore::node_id>> lower;
+        std::map<TripleStore::node_id, std::vector<TripleStore::node_id>> upper;
+
+        inline bool empty() const {
+            return lower.empty() && upper.empty();
+        }
+
+        void sort() {
+            for (auto &property_delta : lower) {
+                std::sort(property_delta.second.begin(), property_delta.second.end());
             }
-            if (contradictsBoundary(tuple, rule.head)) {
-                rule.contradictions++;
+            for (auto &property_delta : upper) {
+                std::sort(property_delta.second.begin(), property_delta.second.end());
             }
         }
 
-        if(body_support > 0) {
-            rule.confidence = (MAX_STANDARD_CONFIDENCE * rule.support) / body_support;
-            rule.contradictions_ratio = (float) rule.contradictions / body_support;
+        inline const std::vector<TripleStore::node_id> &get(const Boundary &boundary) const {
+            static const std::vector<TripleStore::node_id> NO_DELTA;
+            return map_get_value(boundary.is_upper ? upper : lower, boundary.property, NO_DELTA);
         }
-    }
+    };
 
-    std::vector<QueryTuple> evaluateRuleBody(const Rule &rule) {
-        if (rule.body_triples.empty()) {
-            std::vector<QueryTuple> tuples;
-            for (const auto &query_tuple : tuplesForIndividuals) { //TODO: optimize
-                if (matchesBoundaries(query_tuple, rule.body_boundaries)) {
-                    tuples.push_back(query_tuple);
+    //Throws if a bound changed by the last fixpoint iteration makes the lower bound exceed the upper one
+    static void checkConsistency(const BoundsDelta &delta, const std::pair<InferredBounds, InferredBounds> &bounds) {
+        const auto check = [&](const TripleStore::node_id p, const std::vector<TripleStore::node_id> &xs) {
+            for (const auto x : xs) {
+                if (bounds.first.get(x, p).first > bounds.second.get(x, p).first) {
+                    throw std::runtime_error("the fixpoint inferred a lower bound above the upper bound.");
                 }
             }
-            return tuples;
+        };
+        for (const auto &property_delta : delta.lower) {
+            check(property_delta.first, property_delta.second);
+        }
+        for (const auto &property_delta : delta.upper) {
+            check(property_delta.first, property_delta.second);
         }
+    }
 
-        std::vector<QueryTuple> tuples(1);
-        for (const auto &triple : rule.body_triples) {
-            std::vector<QueryTuple> new_tuples;
-            for (const auto &base_tuple : tuples) {
-                if (base_tuple.isBinded(triple.subject)) {
-                    if (base_tuple.isBinded(triple.object)) {
-                        //We verify that the fact exists
-                        if (set_contains(cardinalityStore->pso[triple.property][base_tuple.getValue(triple.subject)], base_tuple.getValue(triple.object))) {
-                            new_tuples.push_back(base_tuple); //Already matches boundaries
-                        }
-                    } else {
-                        //We do join on subject
-                        for (const auto object : cardinalityStore->pso[triple.property][base_tuple.getValue(triple.subject)]) {
-                            auto new_tuple = base_tuple.withValue(triple.object, object);
-                            if (matchesBoundaries(new_tuple, rule.body_boundaries)) {
-                                new_tuples.push_back(new_tuple);
-                            }
-                        }
-                    }
-                } else if (base_tuple.isBinded(triple.object)) {
-                    //We do join on object
-                    for (const auto subject : cardinalityStore->pos[triple.property][base_tuple.getValue(triple.object)]) {
-                        auto new_tuple = base_tuple.withValue(triple.subject, subject);
-                        if (matchesBoundaries(new_tuple, rule.body_boundaries)) {
-                            new_tuples.push_back(new_tuple);
-                        }
-                    }
-                } else {
-                    for (const auto &sos : cardinalityStore->pso[triple.property]) {
-                        for (const auto o : sos.second) {
-                            auto new_tuple = base_tuple
-                                    .withValue(triple.subject, sos.first)
-                                    .withValue(triple.object, o);
-                            if (matchesBoundaries(new_tuple, rule.body_boundaries)) {
-                                new_tuples.push_back(new_tuple);
-                            }
-                        }
-                    }
+    //The bounds of the head property changed by a group of rules during a fixpoint iteration
+    struct GroupChanges {
+        std::unordered_map<TripleStore::node_id, InferredBounds::BoundWithConfidence> lower;
+        std::unordered_map<TripleStore::node_id, InferredBounds::BoundWithConfidence> upper;
+        size_t contradictions = 0;
+    };
+
+    //The x that could match the body only because of the delta: the bounds matched by a body only get tighter
+    std::vector<TripleStore::node_id> getDeltaCandidates(const CompiledBody &body, const BoundsDelta &delta) const {
+        std::vector<TripleStore::node_id> candidates;
+        for (const auto &boundary : body.boundaries_by_variable[0]) {
+            const auto &x_delta = delta.get(boundary);
+            candidates.insert(candidates.end(), x_delta.begin(), x_delta.end());
+        }
+        if (!body.atoms.empty()) {
+            //The x linked to an y of the delta
+            const auto &atom = body.atoms[0];
+            const auto &triple_store = *cardinalityStore->getTripleStore();
+            const auto y_to_x = atom.subject == 0 ? triple_store.getInverseRelation(atom.property)
+                                                  : triple_store.getRelation(atom.property);
+            for (const auto &boundary : body.boundaries_by_variable[1]) {
+                for (const auto y : delta.get(boundary)) {
+                    const auto x_values = y_to_x.getObjects(y);
+                    candidates.insert(candidates.end(), x_values.begin(), x_values.end());
                 }
             }
-            tuples = new_tuples;
         }
-        return tuples;
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        return candidates;
     }
 
-    bool matchesBoundaries(const QueryTuple &tuple, const std::vector<SubjectPredicateBoundary> &boundaries) {
+    static bool matchesBounds(const std::vector<Boundary> &boundaries, const TripleStore::node_id value,
+                              const std::pair<InferredBounds, InferredBounds> &bounds) {
         for (const auto &boundary : boundaries) {
-            if (!matchesBoundary(tuple, boundary)) {
+            if (boundary.is_upper ? boundary.count < bounds.second.get(value, boundary.property).first
+                                  : boundary.count > bounds.first.get(value, boundary.property).first) {
                 return false;
             }
         }
         return true;
     }
 
-    bool matchesBoundary(const QueryTuple &tuple, const SubjectPredicateBoundary &boundary) {
-        if (!tuple.isBinded(boundary.subject)) {
+    //If x matches the body, with at most one triple pattern, according to the inferred bounds
+    bool matchesBody(const CompiledBody &body, const TripleStore::node_id x,
+                     const std::pair<InferredBounds, InferredBounds> &bounds) const {
+        if (!matchesBounds(body.boundaries_by_variable[0], x, bounds)) {
             return false;
         }
-        if (boundary.is_upper) {
-            return boundary.count >=
-                   cardinalityStore->getUpperBound(tuple.getValue(boundary.subject), boundary.property);
-        } else {
-            return boundary.count <=
-                   cardinalityStore->getLowerBound(tuple.getValue(boundary.subject), boundary.property);
+        if (body.atoms.empty()) {
+            return true;
         }
+        const auto &atom = body.atoms[0];
+        const auto &triple_store = *cardinalityStore->getTripleStore();
+        const auto x_to_y = atom.subject == 0 ? triple_store.getRelation(atom.property)
+                                              : triple_store.getInverseRelation(atom.property);
+        for (const auto y : x_to_y.getObjects(x)) {
+            if (matchesBounds(body.boundaries_by_variable[1], y, bounds)) {
+                return true;
+            }
+        }
+        return false;
     }
 
-    bool contradictsBoundary(const QueryTuple &tuple, const SubjectPredicateBoundary &boundary) {
-        if (!tuple.isBinded(boundary.subject)) {
-            return false;
+    //Bitmaps over the individual positions
+    struct BoundaryBitmaps {
+        Bitmap matches;
+        Bitmap contradicts;
+    };
+
+    static inline std::tuple<TripleStore::node_id, size_t, bool> getBoundaryKey(const Boundary &boundary) {
+        return std::make_tuple(boundary.property, boundary.count, boundary.is_upper);
+    }
+
+    void addBoundaryBitmaps(const Boundary &boundary) {
+        BoundaryBitmaps bitmaps = {Bitmap(individuals.size()), Bitmap(individuals.size())};
+        for (size_t i = 0; i < individuals.size(); i++) {
+            if (matches_boundary(*cardinalityStore, individuals[i], boundary)) {
+                bitmaps.matches.set(i);
+            }
+            if (contradicts_boundary(*cardinalityStore, individuals[i], boundary)) {
+                bitmaps.contradicts.set(i);
+            }
+        }
+        boundary_bitmaps.emplace(getBoundaryKey(boundary), std::move(bitmaps));
+    }
+
+    //The boundary should be one of the possible ones of the cardinalities store
+    inline const BoundaryBitmaps &getBoundaryBitmaps(const Boundary &boundary) const {
+        return boundary_bitmaps.at(getBoundaryKey(boundary));
+    }
+
+    //Bindings of a rule body by individual positions: the matching x and, if the body binds y, the matching (x, y) pairs
+    //sorted by x
+    struct BodyBindings {
+        Bitmap x_values;
+        bool binds_y = false;
+        std::vector<std::pair<uint32_t, uint32_t>> xy_values;
+    };
+
+    //The child body is the parent one with the boundary
+    void refineWithBoundary(const BodyBindings &parent, const SubjectPredicateBoundary &boundary, BodyBindings &child) const {
+        const auto &matches = getBoundaryBitmaps(boundary).matches;
+        child.xy_values.clear();
+        child.binds_y = parent.binds_y;
+        if (boundary.subject == 'x') {
+            child.x_values = parent.x_values;
+            child.x_values.andWith(matches);
+            for (const auto &xy : parent.xy_values) {
+                if (child.x_values.test(xy.first)) {
+                    child.xy_values.push_back(xy);
+                }
+            }
+        } else if (boundary.subject == 'y' && parent.binds_y) {
+            child.x_values = parent.x_values;
+            child.x_values.fill(false);
+            for (const auto &xy : parent.xy_values) {
+                if (matches.test(xy.second)) {
+                    child.xy_values.push_back(xy);
+                    child.x_values.set(xy.first);
+                }
+            }
+        } else {
+            throw std::runtime_error(std::string(1, boundary.subject) + " boundary variable is not bound by the parent body.");
         }
-        if (boundary.is_upper) {
-            return boundary.count <
-                   cardinalityStore->getLowerBound(tuple.getValue(boundary.subject), boundary.property);
+    }
+
+    //The child body is the parent one, without y, with the triple pattern between x and y
+    void refineWithTriple(const BodyBindings &parent, const TriplePattern &triple, BodyBindings &child) const {
+        const auto &triple_store = *cardinalityStore->getTripleStore();
+        Relation x_to_y;
+        if (triple.subject == 'x' && triple.object == 'y') {
+            x_to_y = triple_store.getRelation(triple.property);
+        } else if (triple.subject == 'y' && triple.object == 'x') {
+            x_to_y = triple_store.getInverseRelation(triple.property);
         } else {
-            return boundary.count >
-                   cardinalityStore->getUpperBound(tuple.getValue(boundary.subject), boundary.property);
+            throw std::runtime_error("only the triple patterns between x and y could refine a body.");
+        }
+        child.x_values = parent.x_values;
+        child.x_values.fill(false);
+        child.binds_y = true;
+        child.xy_values.clear();
+        for (const auto xy : x_to_y) {
+            const auto x_position = individual_positions[xy.subject];
+            if (!parent.x_values.test(x_position)) {
+                continue;
+            }
+            child.x_values.set(x_position);
+            for (const auto y : xy.objects) {
+                child.xy_values.emplace_back(x_position, individual_positions[y]);
+            }
         }
     }
 
+    //Optionally a C_x: appends to rules the refinements of the head rule with an x boundary improving the confidence
+    void addRulesWithXBounds(const Rule &rule, const BodyBindings &head_bindings,
+                             const std::vector<std::vector<SubjectPredicateBoundary>> &possible_boundaries_with_priority_list,
+                             std::vector<Rule> &rules) const {
+        BodyBindings x_bound_bindings;
+        //We add a C_N(X) with a new property (to avoid trivial rules C_N(X) <= k -> C_N(X) <= k' with k' >= k
+        for (const auto &boundary_list : possible_boundaries_with_priority_list) {
+            Rule parent_rule = rule;
+            for (const auto &boundary : boundary_list) {
+                if (boundary.property != rule.head.property) {
+                    Rule new_rule = rule;
+                    new_rule.body_boundaries.push_back(boundary);
+                    refineWithBoundary(head_bindings, boundary, x_bound_bindings);
+                    addEvaluations(new_rule, x_bound_bindings);
+                    if (new_rule.support >= MIN_SUPPORT && parent_rule.confidence < new_rule.confidence) {
+                        rules.push_back(new_rule);
+                        parent_rule = new_rule;
+                    }
+                }
+            }
+        }
+    }
+
+    //Optionally a P(X,Y) and a C_Y: appends to rules the refinements of the head rule with a triple pattern and
+    //optionally an y boundary improving the confidence.
+    //Each of them is also merged with the rules_with_x_bounds of the same head, the merged rules improving the
+    //confidence of both parents being appended to merged_rules
+    void addRulesWithYBounds(const Rule &rule, const BodyBindings &head_bindings,
+                             const std::vector<std::vector<SubjectPredicateBoundary>> &possible_boundaries_with_priority_list,
+                             std::vector<Rule> &rules, const std::vector<Rule> &rules_with_x_bounds,
+                             std::vector<Rule> &merged_rules) const {
+        BodyBindings triple_bindings;
+        BodyBindings y_bound_bindings;
+        BodyBindings merged_bindings;
+        for (const auto property : cardinalityStore->getProperties()) {
+            std::vector<Rule> new_rules(2, rule); //+p(x,y) and p(y,x)
+            new_rules[0].body_triples.push_back(TriplePattern('x', property, 'y'));
+            new_rules[1].body_triples.push_back(TriplePattern('y', property, 'x'));
+
+            for (Rule &new_rule : new_rules) {
+                refineWithTriple(head_bindings, new_rule.body_triples.back(), triple_bindings);
+                addEvaluations(new_rule, triple_bindings);
+                Rule main_parent_rule = rule;
+                if (new_rule.support >= MIN_SUPPORT && rule.confidence < new_rule.confidence) {
+                    rules.push_back(new_rule);
+                    addMergedRules(new_rule, triple_bindings, rules_with_x_bounds, merged_bindings, merged_rules);
+                    main_parent_rule = new_rule;
+                }
+
+                //We add a C_M(Y)
+                for (const auto &boundary_list : possible_boundaries_with_priority_list) {
+                    Rule parent_rule = main_parent_rule;
+                    for (const auto &boundary : boundary_list) {
+                        Rule new_rule2 = new_rule;
+                        new_rule2.body_boundaries.push_back(
+                                SubjectPredicateBoundary('y', boundary.property, boundary.count,
+                                                         boundary.is_upper));
+                        refineWithBoundary(triple_bindings, new_rule2.body_boundaries.back(), y_bound_bindings);
+                        addEvaluations(new_rule2, y_bound_bindings);
+                        if (new_rule2.support >= MIN_SUPPORT && parent_rule.confidence < new_rule2.confidence) {
+                            rules.push_back(new_rule2);
+                            addMergedRules(new_rule2, y_bound_bindings, rules_with_x_bounds, merged_bindings, merged_rules);
+                            parent_rule = new_rule2;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //The x boundaries only restrict x, so the x of the merged body are the intersection of the ones of its parents
+    void addMergedRules(const Rule &y_rule, const BodyBindings &y_bindings, const std::vector<Rule> &rules_with_x_bounds,
+                        BodyBindings &merged_bindings, std::vector<Rule> &merged_rules) const {
+        for (const auto &x_rule : rules_with_x_bounds) {
+            Rule new_rule = y_rule.mergedWith(x_rule);
+            merged_bindings.x_values = y_bindings.x_values;
+            for (const auto &boundary : x_rule.body_boundaries) {
+                merged_bindings.x_values.andWith(getBoundaryBitmaps(boundary).matches);
+            }
+            addEvaluations(new_rule, merged_bindings);
+            if (new_rule.support >= MIN_SUPPORT && x_rule.confidence < new_rule.confidence &&
+                y_rule.confidence < new_rule.confidence) {
+                merged_rules.push_back(new_rule);
+            }
+        }
+    }
+
+    void addEvaluations(Rule &rule, const BodyBindings &body) const {
+        const auto &body_x_values = body.x_values;
+        const auto &head_bitmaps = getBoundaryBitmaps(rule.head);
+        size_t body_support = body_x_values.count();
+        rule.support = body_x_values.countAnd(head_bitmaps.matches);
+        rule.contradictions = body_x_values.countAnd(head_bitmaps.contradicts);
+        rule.confidence = MAX_STANDARD_CONFIDENCE;
+        rule.contradictions_ratio = 0;
+
+        if(body_support > 0) {
+            rule.confidence = (MAX_STANDARD_CONFIDENCE * rule.support) / body_support;
+            rule.contradictions_ratio = (float) rule.contradictions / body_support;
+        }
+    }
+
+    //Intersection of the individuals matching the boundaries
+    void matchBoundaries(const std::vector<Boundary> &boundaries, Bitmap &matching) const {
+        matching.fill(true);
+        for (const auto &boundary : boundaries) {
+            matching.andWith(getBoundaryBitmaps(boundary).matches);
+        }
+    }
+
+    //Sets x_values to the positions of the x values that could be extended to a binding of the body.
+    //The usual body shapes have their own join kernel, the other ones use the generic join
+    void evaluateRuleBody(const CompiledBody &body, Bitmap &x_values) {
+        if (body.atoms.empty()) {
+            matchBoundaries(body.boundaries_by_variable[0], x_values);
+            return;
+        }
+
+        const auto &triple_store = *cardinalityStore->getTripleStore();
+        const auto add_x = [&](const TripleStore::node_id x) {
+            x_values.set(individual_positions[x]);
+        };
+        if (body.atoms.size() == 1 && body.variables_count == 2) {
+            const auto &atom = body.atoms[0];
+            const auto x_to_y = atom.subject == 0 ? triple_store.getRelation(atom.property)
+                                                  : triple_store.getInverseRelation(atom.property);
+            matchBoundaries(body.boundaries_by_variable[0], x_candidates);
+            const BitmapFilter x_filter(x_candidates, individual_positions);
+            x_values.fill(false);
+            const auto &y_boundaries = body.boundaries_by_variable[1];
+            if (y_boundaries.empty()) {
+                join_single_atom(x_to_y, x_filter, AcceptAll(), add_x);
+            } else {
+                matchBoundaries(y_boundaries, y_candidates);
+                join_single_atom(x_to_y, x_filter, BitmapFilter(y_candidates, individual_positions), add_x);
+            }
+            return;
+        }
+
+        x_values.fill(false);
+        std::vector<variable_id> variable_order;
+        for (size_t i = 0; i < body.variables_count; i++) {
+            variable_order.push_back(i);
+        }
+        const ConjunctiveQuery query(triple_store, body.atoms, variable_order);
+        query.forEach(1, [&](const variable_id variable, const TripleStore::node_id value) {
+            for (const auto &boundary : body.boundaries_by_variable[variable]) {
+                if (!getBoundaryBitmaps(boundary).matches.test(individual_positions[value])) {
+                    return false;
+                }
+            }
+            return true;
+        }, [&](const ConjunctiveQuery::Values &values) {
+            add_x(values[0]);
+        });
+    }
+
     std::shared_ptr<CardinalitiesStore> cardinalityStore;
-    std::vector<QueryTuple> tuplesForIndividuals;
+    //Sorted individuals and the position of each individual id in it
+    std::vector<TripleStore::node_id> individuals;
+    std::vector<uint32_t> individual_positions;
+    std::map<std::tuple<TripleStore::node_id, size_t, bool>, BoundaryBitmaps> boundary_bitmaps;
+    //Buffers of the body evaluated from scratch
+    Bitmap body_x_values;
+    Bitmap x_candidates;
+    Bitmap y_candidates;
 };
 
+//Writes in the directory one <min confidence>.tsv file per minimal confidence with the exact cardinalities having at
+//least this confidence and the statistics about them, in a single pass on the cardinalities
+void write_cardinalities(const std::string &directory, const std::vector<size_t> &min_confidences,
+                         const CardinalityRuleMining::map_id_id_size_t_size_t &new_cardinalities,
+                         const std::pair<InferredBounds, InferredBounds> &cardinalities, const CardinalitiesStore &triples) {
+    const size_t WRITE_BUFFER_SIZE = 1 << 20;
+    std::vector<std::vector<char>> buffers(min_confidences.size(), std::vector<char>(WRITE_BUFFER_SIZE));
+    std::vector<std::unique_ptr<std::ofstream>> streams;
+    for (size_t i = 0; i < min_confidences.size(); i++) {
+        const std::string file_name = directory + "/" + std::to_string(min_confidences[i]) + ".tsv";
+        streams.emplace_back(new std::ofstream());
+        streams.back()->rdbuf()->pubsetbuf(buffers[i].data(), buffers[i].size());
+        streams.back()->open(file_name);
+        if (!streams.back()->is_open()) {
+            throw std::runtime_error(file_name + " is not writable.");
+        }
+    }
+
+    //Counters of the cardinalities by number of minimal confidences they pass, summed afterwards
+    std::vector<size_t> complete(min_confidences.size() + 1, 0);
+    std::vector<size_t> incomplete(min_confidences.size() + 1, 0);
+    std::vector<size_t> missing_size(min_confidences.size() + 1, 0);
+    std::string line;
+    for(const auto& new_cardinality : new_cardinalities) {
+        TripleStore::node_id s = new_cardinality.first.first;
+        TripleStore::node_id p = new_cardinality.first.second;
+        size_t card = new_cardinality.second.first;
+        const size_t passed = std::upper_bound(min_confidences.begin(), min_confidences.end(), new_cardinality.second.second) -
+                              min_confidences.begin();
+        if (passed == 0) {
+            continue;
+        }
+        line = triples.getNodeForId(s).to_string() + '|' + triples.getNodeForId(p).to_string() +
+               "\thasExactCardinality\t" + std::to_string(card) + '\n';
+        for (size_t i = 0; i < passed; i++) {
+            streams[i]->write(line.data(), line.size());
+        }
+        size_t actual_card = triples.getActualCount(s, p);
+        if(actual_card >= card) {
+            complete[passed]++;
+        } else {
+            incomplete[passed]++;
+            missing_size[passed] += (card - actual_card);
+        }
+    }
+
+    const auto count_lower = cardinalities.first.countByMinConfidence(min_confidences);
+    const auto count_upper = cardinalities.second.countByMinConfidence(min_confidences);
+    size_t complete_sum = 0;
+    size_t incomplete_sum = 0;
+    size_t missing_size_sum = 0;
+    for (size_t i = min_confidences.size(); i > 0; i--) {
+        complete_sum += complete[i];
+        incomplete_sum += incomplete[i];
+        missing_size_sum += missing_size[i];
+        auto &output_card_stream = *streams[i - 1];
+        output_card_stream << "dataset\tcompleteCount\t" << complete_sum << '\n';
+        output_card_stream << "dataset\tincompleteCount\t" << incomplete_sum << '\n';
+        output_card_stream << "dataset\tmissingSize\t" << missing_size_sum << '\n';
+        output_card_stream << "dataset\tlowerBoundNumber\t" << count_lower[i - 1] << '\n';
+        output_card_stream << "dataset\tupperBoundNumber\t" << count_upper[i - 1] << '\n';
+        output_card_stream.close();
+    }
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 5) {
-        std::cerr << argv[0] << " input_triples.tsv input_cardinalities.tsv output_rules.tsv output_cardinalities_directory" << std::endl;
+    CommandLine command_line(argc, argv);
+    const auto &arguments = command_line.getArguments();
+    const bool use_snapshot = command_line.hasOption("snapshot");
+    if (arguments.size() < (use_snapshot ? 2 : 4)) {
+        std::cerr << argv[0] << " [--threads N] [--execution once|fixpoint] [--thresholds 0,10,...,100] [--predicates P1,P2] [--subjects subjects.txt] [--strip-prefixes PREFIX1,PREFIX2] input_triples.tsv|input_triples.nt.gz input_cardinalities.tsv output_rules.tsv output_cardinalities_directory" << std::endl;
+        std::cerr << argv[0] << " [--threads N] [--execution once|fixpoint] [--thresholds 0,10,...,100] --snapshot input.snapshot output_rules.tsv output_cardinalities_directory" << std::endl;
         return EXIT_FAILURE;
     }
-    std::string input_triples_file(argv[1]);
-    std::string input_cardinalities_file(argv[2]);
-    std::string output_rules_file(argv[3]);
-    std::string output_cardinalities_directory(argv[4]);
+    size_t argument = 0;
+    std::string input_triples_file = use_snapshot ? "" : arguments[argument++];
+    std::string input_cardinalities_file = use_snapshot ? "" : arguments[argument++];
+    std::string output_rules_file(arguments[argument++]);
+    std::string output_cardinalities_directory(arguments[argument++]);
+
+    //The minimal confidences of the output cardinalities files, in percents
+    std::vector<size_t> min_confidences;
+    for (const auto &value : command_line.getListOption("thresholds")) {
+        if (value.empty() || value.size() > 3 || value.find_first_not_of("0123456789") != std::string::npos ||
+            std::stoul(value) > MAX_STANDARD_CONFIDENCE) {
+            std::cerr << "the thresholds should be integer percents between 0 and " << MAX_STANDARD_CONFIDENCE
+                      << ", got " << value << std::endl;
+            return EXIT_FAILURE;
+        }
+        min_confidences.push_back(std::stoul(value));
+    }
+    if (min_confidences.empty()) {
+        for (size_t min_std_confidence = 0; min_std_confidence <= MAX_STANDARD_CONFIDENCE; min_std_confidence += 10) {
+            min_confidences.push_back(min_std_confidence);
+        }
+    }
+    std::sort(min_confidences.begin(), min_confidences.end());
+    min_confidences.erase(std::unique(min_confidences.begin(), min_confidences.end()), min_confidences.end());
+
     system(("mkdir -p " + output_cardinalities_directory).c_str());
 
     try {
-        std::shared_ptr<CardinalitiesStore> triples = std::make_shared<CardinalitiesStore>();
-        std::cout << "loading triples" << std::endl;
-        triples->loadFile(input_triples_file);
-        std::cout << "loading cardinalities" << std::endl;
-        triples->loadFile(input_cardinalities_file);
-        std::cout << triples->properties.size() << " properties and " << triples->individuals.size()
+        std::shared_ptr<TripleStore> triple_store = std::make_shared<TripleStore>(true);
+        std::unique_ptr<SnapshotReader> snapshot;
+        if (use_snapshot) {
+            std::cout << "loading snapshot" << std::endl;
+            snapshot.reset(new SnapshotReader(command_line.getOption("snapshot")));
+            triple_store->readFrom(*snapshot);
+        }
+        std::shared_ptr<CardinalitiesStore> triples = std::make_shared<CardinalitiesStore>(triple_store);
+        if (use_snapshot) {
+            triples->addStatements(snapshot->getSection<CardinalityStatement>(CARDINALITY_STATEMENTS));
+        } else {
+            std::cout << "loading triples" << std::endl;
+            load_triples(input_triples_file, *triple_store, get_ntriples_filter(command_line));
+            std::cout << "loading cardinalities" << std::endl;
+            triples->addStatements(load_cardinality_statements(input_cardinalities_file, *triple_store));
+        }
+        std::cout << triples->getProperties().size() << " properties and " << triples->individuals.size()
                   << " individuals loaded" << std::endl;
 
         CardinalityRuleMining ruleMining(triples);
@@ -720,7 +1375,10 @@ int main(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
         output_stream << "rule\tstandard_confidence\tnot_contradiction_ratio\n";
-        const auto rules = ruleMining.doMining(1000);
+        const size_t threads_count = command_line.hasOption("threads") ?
+                                     std::stoul(command_line.getOption("threads")) :
+                                     std::max(1u, std::thread::hardware_concurrency());
+        const auto rules = ruleMining.doMining(1000, threads_count);
         for (const auto &rule : rules) {
             addRuleToStream(rule, output_stream, triples);
             output_stream << "\t" << (float) rule.confidence / MAX_STANDARD_CONFIDENCE
@@ -729,56 +1387,15 @@ int main(int argc, char *argv[]) {
         }
         output_stream.close();
 
-        auto cardinalities = ruleMining.executeRules(rules);
-        const auto new_cardinalities = ruleMining.buildExactCardinalities(cardinalities);
-        for(size_t min_std_confidence = 0; min_std_confidence <= MAX_STANDARD_CONFIDENCE; min_std_confidence += 10) {
-            std::string output_cardinalities_file = output_cardinalities_directory + "/" + std::to_string(min_std_confidence) + ".tsv";
-            std::ofstream output_card_stream(output_cardinalities_file);
-            if (!output_card_stream.is_open()) {
-                std::cerr << output_cardinalities_file << " is not writable." << std::endl;
-                return EXIT_FAILURE;
-            }
-            size_t complete = 0;
-            size_t incomplete = 0;
-            size_t missing_size = 0;
-            for(const auto& new_cardinality : new_cardinalities) {
-                TripleStore::node_id s = new_cardinality.first.first;
-                TripleStore::node_id p = new_cardinality.first.second;
-                size_t card = new_cardinality.second.first;
-                if(new_cardinality.second.second >= min_std_confidence) {
-                    output_card_stream << triples->getNodeForId(s) << '|' << triples->getNodeForId(p)
-                                       << "\thasExactCardinality\t" << card << '\n';
-                    size_t actual_card = triples->getActualCount(s, p);
-                    if(actual_card >= card) {
-                        complete++;
-                    } else {
-                        incomplete++;
-                        missing_size += (card - actual_card);
-                    }
-                }
-            }
-
-            output_card_stream << "dataset\tcompleteCount\t" << complete << '\n';
-            output_card_stream << "dataset\tincompleteCount\t" << incomplete << '\n';
-            output_card_stream << "dataset\tmissingSize\t" << missing_size << '\n';
-
-            size_t count_lower = 0;
-            for(const auto& cardinality : cardinalities.first) {
-                if(cardinality.second.second >= min_std_confidence) {
-                    count_lower++;
-                }
-            }
-            output_card_stream << "dataset\tlowerBoundNumber\t" << count_lower << '\n';
-            size_t count_upper = 0;
-            for(const auto& cardinality : cardinalities.second) {
-                if(cardinality.second.second >= min_std_confidence) {
-                    count_upper++;
-                }
-            }
-            output_card_stream << "dataset\tupperBoundNumber\t" << count_upper << '\n';
-
-            output_card_stream.close();
+        const auto execution = command_line.getOption("execution", "once");
+        if (execution != "once" && execution != "fixpoint") {
+            std::cerr << "the execution should be once or fixpoint" << std::endl;
+            return EXIT_FAILURE;
         }
+        auto cardinalities = execution == "fixpoint" ? ruleMining.executeRulesToFixpoint(rules, threads_count)
+                                                     : ruleMining.executeRules(rules);
+        const auto new_cardinalities = ruleMining.buildExactCardinalities(cardinalities);
+        write_cardinalities(output_cardinalities_directory, min_confidences, new_cardinalities, cardinalities, *triples);
 
         return EXIT_SUCCESS;
     } catch (std::exception &e) {
@@ -0,0 +1,52 @@
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "cardinality_statements.h"
+
+MappableVector<CardinalityStatement> load_cardinality_statements(const std::string &file_name, TripleStore &triple_store,
+                                                                 const uint32_t kinds) {
+    const std::experimental::string_view RDF_TYPE("http://www.w3.org/1999/02/22-rdf-syntax-ns#type");
+    const std::experimental::string_view OWL_FUNCTIONAL_PROPERTY("http://www.w3.org/2002/07/owl#FunctionalProperty");
+
+    MappedFile file(file_name);
+    std::vector<CardinalityStatement> statements;
+    const char *cursor = file.data();
+    const char *end = file.data() + file.size();
+    std::experimental::string_view s, p, o;
+    while (cursor != end) {
+        if (!read_triple_line(cursor, end, s, p, o)) {
+            continue;
+        }
+        uint32_t kind;
+        if (p == "hasExactCardinality") {
+            kind = CardinalityStatement::EXACT;
+        } else if (p == "hasAtLeastCardinality") {
+            kind = CardinalityStatement::AT_LEAST;
+        } else if (p == "hasAtMostCardinality") {
+            kind = CardinalityStatement::AT_MOST;
+        } else if (strip_angle_brackets(p) == RDF_TYPE && strip_angle_brackets(o) == OWL_FUNCTIONAL_PROPERTY) {
+            if (!(kinds & (1 << CardinalityStatement::FUNCTIONAL_PROPERTY))) {
+                continue;
+            }
+            const auto property = triple_store.getIdForNode(s);
+            statements.push_back({property, property, CardinalityStatement::FUNCTIONAL_PROPERTY, 1});
+            continue;
+        } else {
+            continue;
+        }
+        if (!(kinds & (1 << kind))) {
+            continue;
+        }
+
+        const auto separator = s.find('|');
+        if (separator == std::experimental::string_view::npos) {
+            throw std::runtime_error("invalid " + p.to_string() + " subject: " + s.to_string());
+        }
+        const auto property = triple_store.getIdForNode(s.substr(separator + 1));
+        const auto subject = triple_store.getIdForNode(s.substr(0, separator));
+        const auto value = (uint32_t) strtoul(o.to_string().c_str(), nullptr, 10);
+        statements.push_back({subject, property, kind, value});
+    }
+    return MappableVector<CardinalityStatement>(std::move(statements));
+}
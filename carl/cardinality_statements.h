@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+#include "triplestore.h"
+
+//A cardinality constraint read from a cardinalities file
+struct CardinalityStatement {
+    enum Kind : uint32_t {
+        EXACT = 0, //SUBJECT|PREDICATE hasExactCardinality VALUE
+        AT_LEAST = 1, //SUBJECT|PREDICATE hasAtLeastCardinality VALUE
+        AT_MOST = 2, //SUBJECT|PREDICATE hasAtMostCardinality VALUE
+        FUNCTIONAL_PROPERTY = 3 //PREDICATE rdf:type owl:FunctionalProperty, subject is the predicate and value is 1
+    };
+
+    node_id subject;
+    node_id property;
+    uint32_t kind;
+    uint32_t value;
+};
+
+const uint32_t ALL_CARDINALITY_STATEMENT_KINDS = 0xf;
+
+//Properties carl-cardinality_patterns bounds to exactly one object per subject. Their nodes are added to the
+//dictionary before the data to get the same node ids from the TSV files and from the snapshots
+const char *const DEFAULT_BOUNDED_PROPERTIES[] = {"P22", "P25"};
+
+//Reads the cardinality statements of the file in file order, other triples are ignored.
+//Only the statements whose kind is in the kinds bit mask (1 << kind) are returned and have their nodes added to the store.
+MappableVector<CardinalityStatement> load_cardinality_statements(const std::string &file_name, TripleStore &triple_store,
+                                                                 uint32_t kinds = ALL_CARDINALITY_STATEMENT_KINDS);
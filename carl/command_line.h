@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Minimal command line parser: "--name value" options may be mixed with positional arguments
+class CommandLine {
+public:
+    CommandLine(int argc, char *argv[]) {
+        for (int i = 1; i < argc; i++) {
+            const std::string argument(argv[i]);
+            if (argument.size() > 2 && argument.compare(0, 2, "--") == 0) {
+                options[argument.substr(2)] = i + 1 < argc ? argv[++i] : "";
+            } else {
+                arguments.push_back(argument);
+            }
+        }
+    }
+
+    inline const std::vector<std::string> &getArguments() const {
+        return arguments;
+    }
+
+    inline bool hasOption(const std::string &name) const {
+        return options.find(name) != options.end();
+    }
+
+    inline std::string getOption(const std::string &name, const std::string &default_value = "") const {
+        const auto iter = options.find(name);
+        return iter == options.end() ? default_value : iter->second;
+    }
+
+    //Comma separated values of the option
+    std::vector<std::string> getListOption(const std::string &name) const {
+        std::vector<std::string> values;
+        std::stringstream stream(getOption(name));
+        std::string value;
+        while (std::getline(stream, value, ',')) {
+            if (!value.empty()) {
+                values.push_back(value);
+            }
+        }
+        return values;
+    }
+
+private:
+    std::vector<std::string> arguments;
+    std::map<std::string, std::string> options;
+};
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include "triplestore.h"
+#include "cardinality_statements.h"
+#include "command_line.h"
+#include "ntriples.h"
+#include "snapshot.h"
+
+//If the node is a property, a subject or an object of the triples, or a node of the statements
+bool is_used_node(const node_id node, const TripleStore &triples, const MappableVector<CardinalityStatement> &statements) {
+    if (set_contains(triples.getProperties(), node)) {
+        return true;
+    }
+    for (const auto property : triples.getProperties()) {
+        if (triples.getRelation(property).getSubjects().contains(node) ||
+            triples.getInverseRelation(property).getSubjects().contains(node)) {
+            return true;
+        }
+    }
+    for (const auto &statement : statements) {
+        if (statement.subject == node || statement.property == node) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    const CommandLine command_line(argc, argv);
+    const auto &arguments = command_line.getArguments();
+    if (arguments.size() < 3) {
+        std::cerr << argv[0] << " [--predicates P1,P2] [--subjects subjects.txt] [--strip-prefixes PREFIX1,PREFIX2] "
+                  << "input_triples.tsv|input_triples.nt.gz input_cardinalities.tsv output.snapshot" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string input_triples_file(arguments[0]);
+    std::string input_cardinalities_file(arguments[1]);
+    std::string output_file(arguments[2]);
+
+    try {
+        TripleStore triples(true);
+        //Added first as carl-cardinality_patterns does when it loads the TSV files
+        std::vector<node_id> default_properties;
+        for (const auto property : DEFAULT_BOUNDED_PROPERTIES) {
+            default_properties.push_back(triples.getIdForNode(property));
+        }
+        load_triples(input_triples_file, triples, get_ntriples_filter(command_line));
+        //The nodes of the exact cardinalities are added first to get the same entities as
+        //carl-patterns_using_cardinalities that only reads these statements
+        const auto exact_statements = load_cardinality_statements(input_cardinalities_file, triples,
+                                                                  1 << CardinalityStatement::EXACT);
+        //carl-patterns_using_cardinalities does not add the default properties
+        uint64_t entity_count = triples.getNumberOfEntities();
+        for (const auto property : default_properties) {
+            if (!is_used_node(property, triples, exact_statements)) {
+                entity_count--;
+            }
+        }
+        const auto statements = load_cardinality_statements(input_cardinalities_file, triples);
+        std::cout << statements.size() << " cardinality statements imported" << std::endl;
+
+        SnapshotWriter writer(output_file);
+        triples.writeTo(writer);
+        writer.addSection(CARDINALITY_STATEMENTS, statements);
+        writer.addSection(EXACT_CARDINALITIES_ENTITY_COUNT, &entity_count, 1);
+        writer.close();
+        return EXIT_SUCCESS;
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
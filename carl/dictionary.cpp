@@ -0,0 +1,86 @@
+#include <string>
+#include <stdexcept>
+
+#include "dictionary.h"
+#include "snapshot.h"
+
+Dictionary::Dictionary() : offsets(1, 0), table(1024, {0, EMPTY_SLOT}) {
+}
+
+node_id Dictionary::getIdForNode(std::experimental::string_view node) {
+    node = strip_angle_brackets(node);
+    const auto node_hash = hash(node);
+    const size_t position = findSlot(node, node_hash);
+    if (table[position].id != EMPTY_SLOT) {
+        return table[position].id;
+    }
+
+    //The node may be a view on a part of the arena that could be reallocated
+    std::string node_copy;
+    if (!arena.empty() && node.data() >= arena.data() && node.data() < arena.data() + arena.size()) {
+        node_copy = node.to_string();
+        node = node_copy;
+    }
+
+    const node_id id = size();
+    auto &arena_values = arena.getMutable();
+    arena_values.insert(arena_values.end(), node.begin(), node.end());
+    offsets.getMutable().push_back(arena_values.size());
+    table.getMutable()[position] = {node_hash, id};
+    if (2 * size() > table.size()) {
+        grow();
+    }
+    return id;
+}
+
+std::experimental::optional<node_id> Dictionary::findIdForNode(std::experimental::string_view node) const {
+    node = strip_angle_brackets(node);
+    const auto &slot = table[findSlot(node, hash(node))];
+    if (slot.id == EMPTY_SLOT) {
+        return {};
+    }
+    return slot.id;
+}
+
+size_t Dictionary::findSlot(const std::experimental::string_view node, const uint32_t node_hash) const {
+    const size_t mask = table.size() - 1;
+    size_t position = node_hash & mask;
+    while (table[position].id != EMPTY_SLOT) {
+        const auto &slot = table[position];
+        if (slot.hash == node_hash && getNodeForId(slot.id) == node) {
+            return position;
+        }
+        position = (position + 1) & mask;
+    }
+    return position;
+}
+
+void Dictionary::grow() {
+    std::vector<Slot> new_table(2 * table.size(), {0, EMPTY_SLOT});
+    const size_t mask = new_table.size() - 1;
+    for (const auto &slot : table) {
+        if (slot.id != EMPTY_SLOT) {
+            size_t position = slot.hash & mask;
+            while (new_table[position].id != EMPTY_SLOT) {
+                position = (position + 1) & mask;
+            }
+            new_table[position] = slot;
+        }
+    }
+    table = std::move(new_table);
+}
+
+void Dictionary::writeTo(SnapshotWriter &writer) const {
+    writer.addSection(DICTIONARY_ARENA, arena);
+    writer.addSection(DICTIONARY_OFFSETS, offsets);
+    writer.addSection(DICTIONARY_TABLE, table);
+}
+
+void Dictionary::readFrom(const SnapshotReader &reader) {
+    arena = reader.getSection<char>(DICTIONARY_ARENA);
+    offsets = reader.getSection<size_t>(DICTIONARY_OFFSETS);
+    table = reader.getSection<Slot>(DICTIONARY_TABLE);
+    if (offsets.empty() || table.empty()) {
+        throw std::runtime_error("the snapshot does not contain a dictionary.");
+    }
+}
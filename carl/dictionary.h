@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <experimental/optional>
+#include <experimental/string_view>
+
+#include "mapped_file.h"
+
+class SnapshotWriter;
+class SnapshotReader;
+
+typedef unsigned int node_id;
+
+//Maps node names to dense ids.
+//Names are stored one after the other in a contiguous arena and looked up using an open addressing hash table.
+//The string_view returned by getNodeForId are invalidated when a new node is added.
+class Dictionary {
+public:
+    Dictionary();
+
+    //Returns the id of the node, adding it if needed. Enclosing <...> are stripped
+    node_id getIdForNode(std::experimental::string_view node);
+
+    //Returns the id of the node if it is already known, without adding it
+    std::experimental::optional<node_id> findIdForNode(std::experimental::string_view node) const;
+
+    inline std::experimental::string_view getNodeForId(const node_id id) const {
+        return std::experimental::string_view(arena.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    inline size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    void writeTo(SnapshotWriter &writer) const;
+
+    //The dictionary content stays in the mapped snapshot until a new node is added
+    void readFrom(const SnapshotReader &reader);
+
+private:
+    struct Slot {
+        uint32_t hash;
+        node_id id;
+    };
+
+    static const node_id EMPTY_SLOT = UINT32_MAX;
+
+    static inline uint32_t hash(const std::experimental::string_view node) {
+        //FNV-1a
+        uint32_t hash = 2166136261u;
+        for (const char c : node) {
+            hash = (hash ^ (unsigned char) c) * 16777619u;
+        }
+        return hash;
+    }
+
+    //Returns the slot of the node or the empty slot where it should be inserted
+    size_t findSlot(std::experimental::string_view node, uint32_t node_hash) const;
+
+    void grow();
+
+    MappableVector<char> arena;
+    MappableVector<size_t> offsets;
+    MappableVector<Slot> table;
+};
+
+inline std::experimental::string_view strip_angle_brackets(std::experimental::string_view node) {
+    while (node.size() >= 2 && node.front() == '<' && node.back() == '>') {
+        node = node.substr(1, node.size() - 2);
+    }
+    return node;
+}
@@ -0,0 +1,57 @@
+#include <stdexcept>
+#include <string>
+
+#include "join.h"
+
+ConjunctiveQuery::ConjunctiveQuery(const TripleStore &triple_store, const std::vector<QueryAtom> &atoms,
+                                   const std::vector<variable_id> &variable_order) : atoms_count(atoms.size()) {
+    if (variable_order.size() > MAX_QUERY_VARIABLES) {
+        throw std::runtime_error("queries are limited to " + std::to_string(MAX_QUERY_VARIABLES) + " variables.");
+    }
+    std::array<size_t, MAX_QUERY_VARIABLES> depth_of_variable;
+    depth_of_variable.fill(MAX_QUERY_VARIABLES);
+    for (size_t depth = 0; depth < variable_order.size(); depth++) {
+        if (variable_order[depth] >= MAX_QUERY_VARIABLES) {
+            throw std::runtime_error("invalid query variable " + std::to_string(variable_order[depth]) + ".");
+        }
+        depth_of_variable[variable_order[depth]] = depth;
+    }
+
+    for (size_t depth = 0; depth < variable_order.size(); depth++) {
+        Level level;
+        level.variable = variable_order[depth];
+        for (size_t i = 0; i < atoms.size(); i++) {
+            const auto &atom = atoms[i];
+            if (atom.subject >= MAX_QUERY_VARIABLES || depth_of_variable[atom.subject] == MAX_QUERY_VARIABLES ||
+                atom.object >= MAX_QUERY_VARIABLES || depth_of_variable[atom.object] == MAX_QUERY_VARIABLES) {
+                throw std::runtime_error("the query atoms should only use the variables of the order.");
+            }
+            if (atom.subject == level.variable && atom.object == level.variable) {
+                level.sources.push_back({triple_store.getRelation(atom.property), false, i});
+                level.self_loops.push_back(triple_store.getRelation(atom.property));
+            } else if (atom.subject == level.variable) {
+                if (depth_of_variable[atom.object] < depth) {
+                    if (!triple_store.hasInverseIndex()) {
+                        throw std::runtime_error("this query requires the inverse index of the triple store.");
+                    }
+                    level.sources.push_back({triple_store.getInverseRelation(atom.property), true, i});
+                } else {
+                    level.sources.push_back({triple_store.getRelation(atom.property), false, i});
+                }
+            } else if (atom.object == level.variable) {
+                if (depth_of_variable[atom.subject] < depth) {
+                    level.sources.push_back({triple_store.getRelation(atom.property), true, i});
+                } else {
+                    if (!triple_store.hasInverseIndex()) {
+                        throw std::runtime_error("this query requires the inverse index of the triple store.");
+                    }
+                    level.sources.push_back({triple_store.getInverseRelation(atom.property), false, i});
+                }
+            }
+        }
+        if (level.sources.empty()) {
+            throw std::runtime_error("the query variable " + std::to_string(level.variable) + " is not used by any atom.");
+        }
+        levels.push_back(level);
+    }
+}
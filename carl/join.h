@@ -0,0 +1,191 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "triplestore.h"
+
+typedef uint8_t variable_id;
+
+const size_t MAX_QUERY_VARIABLES = 8;
+
+//property(subject, object) where subject and object are variables
+struct QueryAtom {
+    node_id property;
+    variable_id subject;
+    variable_id object;
+};
+
+//Advances first to the first value >= value using an exponential then a binary search
+inline const node_id *seek(const node_id *first, const node_id *last, const node_id value) {
+    size_t step = 1;
+    while (first + step < last && first[step] < value) {
+        first += step;
+        step *= 2;
+    }
+    return std::lower_bound(first, std::min(first + step + 1, last), value);
+}
+
+//Calls callback(value) for each value contained in all the ranges, in increasing order, until it returns false.
+//Returns false if the callback stopped the iteration. During the callback, cursors[i] points to value in ranges[i]
+template <typename Callback>
+bool leapfrog_intersection(const std::vector<IdRange> &ranges, std::vector<const node_id *> &cursors, Callback callback) {
+    for (const auto &range : ranges) {
+        if (range.empty()) {
+            return true;
+        }
+    }
+    cursors.clear();
+    for (const auto &range : ranges) {
+        cursors.push_back(range.begin());
+    }
+    if (ranges.size() == 1) {
+        for (auto &cursor = cursors[0]; cursor != ranges[0].end(); cursor++) {
+            if (!callback(*cursor)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    const size_t count = ranges.size();
+    size_t current = 0;
+    node_id max_value = 0;
+    for (const auto cursor : cursors) {
+        max_value = std::max(max_value, *cursor);
+    }
+    size_t matching = 0;
+    while (true) {
+        auto &cursor = cursors[current];
+        cursor = seek(cursor, ranges[current].end(), max_value);
+        if (cursor == ranges[current].end()) {
+            return true;
+        }
+        if (*cursor == max_value) {
+            matching++;
+            if (matching == count) {
+                if (!callback(max_value)) {
+                    return false;
+                }
+                cursor++;
+                if (cursor == ranges[current].end()) {
+                    return true;
+                }
+                //The next value of this cursor is checked again against the other ones
+                max_value = *cursor;
+                matching = 0;
+                continue;
+            }
+        } else {
+            max_value = *cursor;
+            matching = 1;
+        }
+        if (++current == count) {
+            current = 0;
+        }
+    }
+}
+
+//Conjunctive query evaluated with the leapfrog triejoin worst-case optimal join:
+//variables are bound one after the other in the given order and the values of each of them are the intersection
+//of the sorted ranges given by the atoms it appears in.
+class ConjunctiveQuery {
+public:
+    //Each variable of the order should appear in an atom. If an atom object is bound before its subject,
+    //the store should have its inverse index
+    ConjunctiveQuery(const TripleStore &triple_store, const std::vector<QueryAtom> &atoms,
+                     const std::vector<variable_id> &variable_order);
+
+    typedef std::array<node_id, MAX_QUERY_VARIABLES> Values;
+
+    //Calls callback(values) once for each distinct binding of the first output_count variables of the order that
+    //could be extended to the whole query, in lexicographic order. values is indexed by variable id.
+    //filter(variable, value) could reject values of a variable before they are joined further
+    template <typename Filter, typename Callback>
+    void forEach(const size_t output_count, Filter filter, Callback callback) const {
+        State state;
+        state.values.fill(0);
+        state.buffers.resize(levels.size());
+        state.subject_positions.resize(atoms_count);
+        search(0, output_count, state, filter, callback);
+    }
+
+private:
+    //A range of values for the variable of a level, the other variable of the atom being bound before or not
+    struct RangeSource {
+        Relation relation;
+        bool bound; //If true, the range is the objects in relation of the other variable of the atom, else relation.getSubjects()
+        size_t atom;
+    };
+
+    struct Level {
+        variable_id variable;
+        std::vector<RangeSource> sources;
+        std::vector<Relation> self_loops; //Atoms p(v, v)
+    };
+
+    //Scratch buffers of a level, reused between its searches
+    struct Buffers {
+        std::vector<IdRange> ranges;
+        std::vector<const node_id *> cursors;
+    };
+
+    struct State {
+        Values values;
+        std::vector<Buffers> buffers;
+        //For each atom, the position in its relation subjects of the value bound to the variable of its unbound source.
+        //Its bound source reads the objects at this position without searching the subject again
+        std::vector<size_t> subject_positions;
+    };
+
+    template <typename Filter, typename Callback>
+    bool search(const size_t depth, const size_t output_count, State &state, Filter &filter, Callback &callback) const {
+        if (depth == levels.size()) {
+            return true;
+        }
+        const auto &level = levels[depth];
+        auto &values = state.values;
+        auto &ranges = state.buffers[depth].ranges;
+        const auto &cursors = state.buffers[depth].cursors;
+        ranges.clear();
+        for (const auto &source : level.sources) {
+            ranges.push_back(source.bound ? source.relation.getObjectsAt(state.subject_positions[source.atom])
+                                          : source.relation.getSubjects());
+        }
+        //The values of the last level do not need to be extended further
+        const bool last = depth + 1 == levels.size();
+        bool found = false;
+        leapfrog_intersection(ranges, state.buffers[depth].cursors, [&](const node_id value) {
+            for (const auto &relation : level.self_loops) {
+                if (!relation.contains(value, value)) {
+                    return true;
+                }
+            }
+            if (!filter(level.variable, value)) {
+                return true;
+            }
+            values[level.variable] = value;
+            for (size_t i = 0; i < level.sources.size(); i++) {
+                if (!level.sources[i].bound) {
+                    state.subject_positions[level.sources[i].atom] = cursors[i] - ranges[i].begin();
+                }
+            }
+            if (depth >= output_count) {
+                //Only the existence of an extension matters
+                found = last || search(depth + 1, output_count, state, filter, callback);
+                return !found;
+            }
+            if (last || search(depth + 1, output_count, state, filter, callback)) {
+                found = true;
+                if (depth + 1 == output_count) {
+                    callback(values);
+                }
+            }
+            return true;
+        });
+        return found;
+    }
+
+    std::vector<Level> levels;
+    size_t atoms_count;
+};
@@ -0,0 +1,69 @@
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string &file_name) {
+    const int file_descriptor = open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor == -1) {
+        throw std::runtime_error(file_name + " is not readable.");
+    }
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+        content_size = (size_t) file_stat.st_size;
+        if (content_size > 0) {
+            void *mapping = mmap(nullptr, content_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+            if (mapping == MAP_FAILED) {
+                close(file_descriptor);
+                throw std::runtime_error(file_name + " could not be mapped in memory.");
+            }
+            madvise(mapping, content_size, MADV_SEQUENTIAL);
+            content = static_cast<const char *>(mapping);
+            is_mapped = true;
+        }
+        close(file_descriptor);
+        return;
+    }
+    close(file_descriptor);
+
+    std::ifstream input_stream(file_name, std::ios::binary);
+    if (!input_stream.is_open()) {
+        throw std::runtime_error(file_name + " is not readable.");
+    }
+    buffer.assign(std::istreambuf_iterator<char>(input_stream), std::istreambuf_iterator<char>());
+    content = buffer.data();
+    content_size = buffer.size();
+}
+
+MappedFile::~MappedFile() {
+    if (is_mapped) {
+        munmap(const_cast<char *>(content), content_size);
+    }
+}
+
+std::vector<std::pair<const char *, const char *>> MappedFile::splitInLines(size_t chunks_count) const {
+    std::vector<std::pair<const char *, const char *>> chunks;
+    const char *end = content + content_size;
+    const char *chunk_begin = content;
+    for (size_t i = 1; i <= chunks_count && chunk_begin != end; i++) {
+        const char *chunk_end = i == chunks_count ? end : content + (content_size * i) / chunks_count;
+        if (chunk_end < chunk_begin) {
+            chunk_end = chunk_begin;
+        }
+        while (chunk_end != end && *chunk_end != '\n') {
+            chunk_end++;
+        }
+        if (chunk_end != end) {
+            chunk_end++; //The line break is kept in the chunk
+        }
+        chunks.push_back(std::make_pair(chunk_begin, chunk_end));
+        chunk_begin = chunk_end;
+    }
+    return chunks;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <experimental/string_view>
+
+//Read-only content of a file, memory-mapped if it is a regular file and read in memory else (pipes, /dev/null...)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &file_name);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    inline const char *data() const {
+        return content;
+    }
+
+    inline size_t size() const {
+        return content_size;
+    }
+
+    //Splits the content in at most chunks_count ranges that all start at the beginning of a line
+    std::vector<std::pair<const char *, const char *>> splitInLines(size_t chunks_count) const;
+
+private:
+    const char *content = nullptr;
+    size_t content_size = 0;
+    bool is_mapped = false;
+    std::vector<char> buffer;
+};
+
+//Array that either owns its values or is a view on a mapped file, kept alive by the array.
+//Mapped arrays are copied in memory on their first modification.
+template <typename T>
+class MappableVector {
+public:
+    MappableVector() = default;
+
+    MappableVector(size_t count, const T &value) : values(count, value) {}
+
+    MappableVector(std::vector<T> &&values) : values(std::move(values)) {}
+
+    MappableVector(const T *mapped_data, size_t mapped_size, std::shared_ptr<const void> owner) :
+            mapped_data(mapped_data), mapped_size(mapped_size), is_mapped(true), owner(owner) {}
+
+    inline const T *data() const {
+        return is_mapped ? mapped_data : values.data();
+    }
+
+    inline size_t size() const {
+        return is_mapped ? mapped_size : values.size();
+    }
+
+    inline bool empty() const {
+        return size() == 0;
+    }
+
+    inline const T *begin() const {
+        return data();
+    }
+
+    inline const T *end() const {
+        return data() + size();
+    }
+
+    inline const T &operator[](size_t position) const {
+        return data()[position];
+    }
+
+    std::vector<T> &getMutable() {
+        if (is_mapped) {
+            values.assign(mapped_data, mapped_data + mapped_size);
+            is_mapped = false;
+            mapped_data = nullptr;
+            mapped_size = 0;
+            owner.reset();
+        }
+        return values;
+    }
+
+private:
+    std::vector<T> values;
+    const T *mapped_data = nullptr;
+    size_t mapped_size = 0;
+    bool is_mapped = false;
+    std::shared_ptr<const void> owner;
+};
+
+inline bool is_space(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+//Reads the three first whitespace separated tokens of the line starting at cursor and moves cursor to the next line.
+//Follows the semantic of std::getline followed by "line_stream >> s >> p >> o": returns false if the line has less than three tokens
+inline bool read_triple_line(const char *&cursor, const char *end, std::experimental::string_view &subject,
+                             std::experimental::string_view &predicate, std::experimental::string_view &object) {
+    std::experimental::string_view *tokens[3] = {&subject, &predicate, &object};
+    size_t tokens_count = 0;
+    while (cursor != end && *cursor != '\n') {
+        if (is_space(*cursor)) {
+            cursor++;
+            continue;
+        }
+        const char *token_begin = cursor;
+        while (cursor != end && !is_space(*cursor)) {
+            cursor++;
+        }
+        if (tokens_count < 3) {
+            *tokens[tokens_count] = std::experimental::string_view(token_begin, cursor - token_begin);
+        }
+        tokens_count++;
+    }
+    if (cursor != end) {
+        cursor++; //We skip the line break
+    }
+    return tokens_count >= 3;
+}
@@ -0,0 +1,253 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#ifdef CARL_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include "ntriples.h"
+
+namespace {
+const size_t READ_BLOCK_SIZE = 1 << 20;
+
+//Sequential reader of a file that is decompressed on the fly if needed
+class InputStream {
+public:
+    explicit InputStream(const std::string &file_name) : file_name(file_name) {
+#ifdef CARL_WITH_ZLIB
+        //gzread also reads files that are not compressed
+        file = gzopen(file_name.c_str(), "rb");
+        if (file == nullptr) {
+            throw std::runtime_error(file_name + " is not readable.");
+        }
+        gzbuffer(file, READ_BLOCK_SIZE);
+#else
+        if (file_name.size() > 3 && file_name.compare(file_name.size() - 3, 3, ".gz") == 0) {
+            throw std::runtime_error(file_name + " is compressed but CARL has been built without zlib.");
+        }
+        stream.open(file_name, std::ios::binary);
+        if (!stream.is_open()) {
+            throw std::runtime_error(file_name + " is not readable.");
+        }
+#endif
+    }
+
+    ~InputStream() {
+#ifdef CARL_WITH_ZLIB
+        gzclose(file);
+#endif
+    }
+
+    //Returns the number of bytes read, 0 at the end of the file
+    size_t read(char *buffer, const size_t size) {
+#ifdef CARL_WITH_ZLIB
+        const int read_size = gzread(file, buffer, (unsigned int) size);
+        if (read_size < 0) {
+            int error_code;
+            throw std::runtime_error("error while reading " + file_name + ": " + gzerror(file, &error_code));
+        }
+        return (size_t) read_size;
+#else
+        stream.read(buffer, size);
+        if (stream.bad()) {
+            throw std::runtime_error("error while reading " + file_name + ".");
+        }
+        return (size_t) stream.gcount();
+#endif
+    }
+
+private:
+    std::string file_name;
+#ifdef CARL_WITH_ZLIB
+    gzFile file;
+#else
+    std::ifstream stream;
+#endif
+};
+
+inline void skip_spaces(const char *&cursor, const char *end) {
+    while (cursor != end && is_space(*cursor)) {
+        cursor++;
+    }
+}
+
+//Reads an IRI, a blank node or a literal. Returns false if the term is malformed
+bool read_term(const char *&cursor, const char *end, std::experimental::string_view &term) {
+    skip_spaces(cursor, end);
+    const char *begin = cursor;
+    if (cursor == end) {
+        return false;
+    }
+    if (*cursor == '<') {
+        while (cursor != end && *cursor != '>') {
+            cursor++;
+        }
+        if (cursor == end) {
+            return false;
+        }
+        cursor++;
+    } else if (*cursor == '"') {
+        cursor++;
+        while (cursor != end && *cursor != '"') {
+            if (*cursor == '\\' && cursor + 1 != end) {
+                cursor++;
+            }
+            cursor++;
+        }
+        if (cursor == end) {
+            return false;
+        }
+        cursor++;
+        //Language tag or datatype
+        if (cursor != end && (*cursor == '@' || *cursor == '^')) {
+            while (cursor != end && !is_space(*cursor) && !(*cursor == '.' && (cursor + 1 == end || is_space(cursor[1])))) {
+                cursor++;
+            }
+        }
+    } else if (*cursor == '_') {
+        while (cursor != end && !is_space(*cursor)) {
+            cursor++;
+        }
+    } else {
+        return false;
+    }
+    term = std::experimental::string_view(begin, cursor - begin);
+    return true;
+}
+
+//Removes the <> of the IRIs and the first matching prefix
+std::experimental::string_view normalize_term(std::experimental::string_view term, const std::vector<std::string> &prefixes) {
+    if (term.empty() || term.front() != '<') {
+        return term;
+    }
+    term = term.substr(1, term.size() - 2);
+    for (const auto &prefix : prefixes) {
+        if (term.size() > prefix.size() && term.compare(0, prefix.size(), prefix) == 0) {
+            return term.substr(prefix.size());
+        }
+    }
+    return term;
+}
+
+Dictionary to_dictionary(const std::vector<std::string> &nodes) {
+    Dictionary dictionary;
+    for (const auto &node : nodes) {
+        dictionary.getIdForNode(node);
+    }
+    return dictionary;
+}
+}
+
+void load_ntriples(const std::string &file_name, TripleStore &triple_store, const NTriplesFilter &filter) {
+    const auto start_time = std::chrono::steady_clock::now();
+    //Dictionaries allow to test the filters without copying the terms
+    const auto predicates = to_dictionary(filter.predicates);
+    const auto subjects = to_dictionary(filter.subjects);
+
+    InputStream input(file_name);
+    std::unique_ptr<char[]> buffer(new char[READ_BLOCK_SIZE]);
+    size_t buffer_size = 0;
+    size_t line_number = 0;
+    size_t imported = 0;
+    size_t filtered = 0;
+    bool end_of_file = false;
+    while (!end_of_file) {
+        const size_t read_size = input.read(buffer.get() + buffer_size, READ_BLOCK_SIZE - buffer_size);
+        end_of_file = read_size == 0;
+        buffer_size += read_size;
+        const char *end = buffer.get() + buffer_size;
+
+        //We only parse the complete lines, the last one if we are at the end of the file
+        const char *cursor = buffer.get();
+        while (cursor != end) {
+            const char *line_end = cursor;
+            while (line_end != end && *line_end != '\n') {
+                line_end++;
+            }
+            if (line_end == end && !end_of_file) {
+                break;
+            }
+            line_number++;
+
+            const char *line_begin = cursor;
+            const char *line_cursor = cursor;
+            cursor = line_end == end ? end : line_end + 1;
+            skip_spaces(line_cursor, line_end);
+            if (line_cursor == line_end || *line_cursor == '#') {
+                continue;
+            }
+            std::experimental::string_view s, p, o;
+            if (!read_term(line_cursor, line_end, s) || !read_term(line_cursor, line_end, p) ||
+                !read_term(line_cursor, line_end, o)) {
+                throw std::runtime_error("invalid N-Triples line " + std::to_string(line_number) + " of " + file_name +
+                                         ": " + std::string(line_begin, line_end));
+            }
+            s = normalize_term(s, filter.stripped_prefixes);
+            p = normalize_term(p, filter.stripped_prefixes);
+            o = normalize_term(o, filter.stripped_prefixes);
+            if ((!filter.predicates.empty() && !predicates.findIdForNode(p)) ||
+                (!filter.subjects.empty() && !subjects.findIdForNode(s))) {
+                filtered++;
+                continue;
+            }
+            triple_store.addTriple(s, p, o);
+            imported++;
+        }
+
+        if (!end_of_file && cursor == buffer.get()) {
+            throw std::runtime_error("the line " + std::to_string(line_number + 1) + " of " + file_name +
+                                     " is longer than " + std::to_string(READ_BLOCK_SIZE) + " bytes.");
+        }
+        buffer_size = end - cursor;
+        std::copy(cursor, end, buffer.get());
+    }
+    triple_store.buildIndex();
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start_time;
+    std::cout << imported << " facts imported in " << duration.count() << "s (" << (size_t) (imported / duration.count())
+              << " facts/s)" << std::endl;
+    if (filtered > 0) {
+        std::cout << filtered << " facts filtered out" << std::endl;
+    }
+}
+
+bool is_ntriples_file(const std::string &file_name) {
+    for (const std::string suffix : {".nt", ".nt.gz"}) {
+        if (file_name.size() >= suffix.size() &&
+            file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void load_triples(const std::string &file_name, TripleStore &triple_store, const NTriplesFilter &filter) {
+    if (is_ntriples_file(file_name)) {
+        load_ntriples(file_name, triple_store, filter);
+    } else {
+        triple_store.loadFile(file_name);
+    }
+}
+
+NTriplesFilter get_ntriples_filter(const CommandLine &command_line) {
+    NTriplesFilter filter;
+    filter.stripped_prefixes = command_line.getListOption("strip-prefixes");
+    filter.predicates = command_line.getListOption("predicates");
+    if (command_line.hasOption("subjects")) {
+        const auto file_name = command_line.getOption("subjects");
+        std::ifstream input_stream(file_name);
+        if (!input_stream.is_open()) {
+            throw std::runtime_error(file_name + " is not readable.");
+        }
+        std::string line;
+        while (std::getline(input_stream, line)) {
+            if (!line.empty()) {
+                filter.subjects.push_back(line);
+            }
+        }
+    }
+    return filter;
+}
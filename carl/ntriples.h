@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "command_line.h"
+#include "triplestore.h"
+
+//Restricts the triples loaded by load_ntriples. Empty lists do not filter anything
+struct NTriplesFilter {
+    //Prefixes removed from the IRIs, the first matching one is used
+    std::vector<std::string> stripped_prefixes;
+    //Predicates and subjects to keep, after the prefixes removal
+    std::vector<std::string> predicates;
+    std::vector<std::string> subjects;
+};
+
+//Streams an N-Triples file, gzip compressed if CARL is built with zlib, into the store and builds its index.
+//IRIs are stored without their enclosing <>. Literals and blank nodes are stored as written in the file.
+void load_ntriples(const std::string &file_name, TripleStore &triple_store, const NTriplesFilter &filter = NTriplesFilter());
+
+//If the file name ends with .nt or .nt.gz
+bool is_ntriples_file(const std::string &file_name);
+
+//Loads the N-Triples file with load_ntriples or else the TSV file with TripleStore::loadFile, that is not filtered
+void load_triples(const std::string &file_name, TripleStore &triple_store, const NTriplesFilter &filter = NTriplesFilter());
+
+//Filter given by the options --strip-prefixes PREFIX1,PREFIX2 --predicates P1,P2 --subjects subjects.txt,
+//the subjects file containing one subject per line
+NTriplesFilter get_ntriples_filter(const CommandLine &command_line);
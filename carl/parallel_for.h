@@ -0,0 +1,24 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//Calls task(i, thread) for each i in [0, count), the workers taking the tasks one after the other
+template <typename Task>
+void parallel_for(const size_t count, const size_t threads_count, Task task) {
+    std::atomic<size_t> next(0);
+    const auto work = [&](const size_t thread) {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i, thread);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threads_count; i++) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
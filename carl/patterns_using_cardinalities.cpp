@@ -6,15 +6,31 @@
 #include <algorithm>
 #include <memory>
 #include <sstream>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
 
 #include <stdlib.h>
 
 #include "triplestore.h"
+#include "cardinality_statements.h"
+#include "command_line.h"
+#include "ntriples.h"
+#include "snapshot.h"
+#include "top_k.h"
+#include "join.h"
+#include "parallel_for.h"
 
 const double MIN_HEAD_COVERAGE = 0.001;
 const double MIN_STANDARD_CONFIDENCE = 0.001;
 const size_t MIN_SUPPORT = 10;
 const double CONFIDENCE_INCOMPLETENESS_FACTOR = 0.5;
+const double CONFIDENCE_INTERVAL_LEVEL = 95;
+const double CONFIDENCE_INTERVAL_Z = 1.96;
 
 
 //p(x,y) /\ q(y,z) -> r(x,z)
@@ -39,48 +55,77 @@ struct ScoredRule {
     double directional_coef;
 };
 
+//Ranks the rules by decreasing completeness confidence, then by body and head
+struct BetterCompletenessConfidence {
+    inline bool operator()(const ScoredRule &a, const ScoredRule &b) const {
+        if (a.completeness_confidence != b.completeness_confidence) {
+            return a.completeness_confidence > b.completeness_confidence;
+        }
+        return std::tie(a.p, a.q, a.r) < std::tie(b.p, b.q, b.r);
+    }
+};
+
+typedef TopK<ScoredRule, BetterCompletenessConfidence> TopScoredRules;
+
+//Counters of a rule all its metrics are computed from, kept between runs for incremental mining
+struct RuleCounters {
+    size_t support;
+    size_t body_support;
+    size_t pca_support;
+    size_t triple_added_to_missing_places_count;
+    size_t triple_added_to_complete_places_count;
+};
+
+typedef std::map<std::tuple<TripleStore::node_id, TripleStore::node_id, TripleStore::node_id>, RuleCounters> RuleCountersMap;
+
+//Counters kept between runs for incremental mining: the counters of the rules passing the thresholds
+//and the number of (x, z) pairs of each body p(x,y) /\ q(y,z) that could reach the minimal support
+struct MiningCounters {
+    RuleCountersMap rules;
+    std::map<std::pair<TripleStore::node_id, TripleStore::node_id>, size_t> body_supports;
+};
+
+//Triples and exact cardinalities appended to the inputs since the counters have been recorded
+struct AppendedLines {
+    //For each property, its appended (subject, object) pairs, sorted
+    std::map<TripleStore::node_id, std::vector<std::pair<TripleStore::node_id, TripleStore::node_id>>> triples;
+    //Properties with appended exact cardinalities
+    std::set<TripleStore::node_id> exact_cardinality_properties;
+};
+
 class CardinalitiesStore {
 public:
     CardinalitiesStore(std::shared_ptr<TripleStore> triple_store) : triple_store(triple_store) {}
 
-    inline bool hasExpectedCardinality(const TripleStore::node_id s, const TripleStore::node_id p) {
-        return map_has_key(expected_cardinalities_by_property_value[p], s);
+    inline bool hasExpectedCardinality(const TripleStore::node_id s, const TripleStore::node_id p) const {
+        return (bool) getExpectedCardinality(s, p);
     }
 
     inline std::experimental::optional<size_t>
-    getExpectedCardinality(const TripleStore::node_id s, const TripleStore::node_id p) {
-        return map_get_value(expected_cardinalities_by_property_value[p], s);
+    getExpectedCardinality(const TripleStore::node_id s, const TripleStore::node_id p) const {
+        const auto property_cardinalities = expected_cardinalities_by_property_value.find(p);
+        if (property_cardinalities == expected_cardinalities_by_property_value.end()) {
+            return {};
+        }
+        return map_get_value(property_cardinalities->second, s);
+    }
+
+    //The subject -> expected cardinality map of the property, sorted by subject
+    inline const std::map<TripleStore::node_id, size_t> &getExpectedCardinalities(const TripleStore::node_id p) const {
+        static const std::map<TripleStore::node_id, size_t> NO_CARDINALITIES;
+        return map_get_value(expected_cardinalities_by_property_value, p, NO_CARDINALITIES);
     }
 
     void loadFile(const std::string &file_name) {
-        std::ifstream input_stream(file_name);
-        if (!input_stream.is_open()) {
-            throw std::runtime_error(file_name + " is not readable.");
-        }
-        std::string s, p, o;
-        std::string line;
-        while (std::getline(input_stream, line)) {
-            std::istringstream line_stream(line);
-            if(!(line_stream >> s >> p >> o)) {
-                continue;
-            }
-            if (p == "hasExactCardinality") {
-                if(s.find_first_of('|') != std::string::npos) {
-                    std::string subject;
-                    size_t i = 0;
-                    for (; i < s.size() && s[i] != '|'; i++) {
-                        subject.push_back(s[i]);
-                    }
-                    std::string predicate = s.substr(i + 1, std::string::npos);
-                    expected_cardinalities_by_property_value[triple_store->getIdForNode(predicate)]
-                                                            [triple_store->getIdForNode(subject)] =
-                                                                                        strtoul(o.c_str(), nullptr, 10);
-                } else {
-                    throw std::runtime_error("invalid hasExactCardinality subject");
-                }
+        addStatements(load_cardinality_statements(file_name, *triple_store, 1 << CardinalityStatement::EXACT));
+    }
+
+    void addStatements(const MappableVector<CardinalityStatement> &statements) {
+        for (const auto &statement : statements) {
+            if (statement.kind == CardinalityStatement::EXACT) {
+                expected_cardinalities_by_property_value[statement.property][statement.subject] = statement.value;
             }
         }
-        input_stream.close();
     }
 
 private:
@@ -88,209 +133,954 @@ private:
     std::map<TripleStore::node_id, std::map<TripleStore::node_id, size_t>> expected_cardinalities_by_property_value;
 };
 
+//A subject with an expected cardinality for a relation and its number of missing objects
+struct ExpectedSlot {
+    TripleStore::node_id subject;
+    size_t missing;
+};
+
+//Linear merge cursor on the sorted expected slots of a relation: the subjects should be looked up in increasing order
+class ExpectedSlotsCursor {
+public:
+    ExpectedSlotsCursor(const std::vector<ExpectedSlot> &slots) : current(slots.data()), last(slots.data() + slots.size()) {}
+
+    //Returns nullptr if the subject has no expected cardinality
+    inline const ExpectedSlot *find(const TripleStore::node_id subject) {
+        while (current != last && current->subject < subject) {
+            current++;
+        }
+        return current != last && current->subject == subject ? current : nullptr;
+    }
+
+private:
+    const ExpectedSlot *current;
+    const ExpectedSlot *last;
+};
+
 class CardinalityRuleMining {
 public:
     CardinalityRuleMining(std::shared_ptr<TripleStore> tripleStore,
-                          std::shared_ptr<CardinalitiesStore> cardinalitiesStore) :
-            tripleStore(tripleStore), cardinalityStore(cardinalitiesStore) {}
+                          std::shared_ptr<CardinalitiesStore> cardinalitiesStore, size_t entity_count) :
+            tripleStore(tripleStore), cardinalityStore(cardinalitiesStore), entity_count(entity_count) {}
 
-    std::vector<ScoredRule> doMining(size_t output_k_rules) {
-        //Count number of triples per relations and number of entities
-        std::set<TripleStore::node_id> entities;
-        std::map<TripleStore::node_id, size_t> property_instances_count;
-        size_t entity_count = tripleStore->getNumberOfEntities();
-        for (const auto &pxy : tripleStore->pso) {
-            for (const auto &xy : pxy.second) {
-                property_instances_count[pxy.first] += xy.second.size();
+    //The counters of all the rules passing the thresholds and the body supports are written to counters by the next
+    //doMining call
+    void recordCounters(MiningCounters &counters) {
+        recorded_counters = &counters;
+    }
+
+    //The next doMining call reuses the counters of the previous run for the bodies without appended triples:
+    //the rules whose head has no appended line are rebuilt from their counters and the other ones are updated on the
+    //subjects of the appended lines, see updateBody. The counters should have been recorded on the same data without
+    //the appended lines, that should not be already in the data
+    void reuseCounters(const MiningCounters &counters, const AppendedLines &lines) {
+        previous_counters = &counters;
+        appended_lines = &lines;
+        changed_bodies_properties.clear();
+        changed_heads.clear();
+        appended_subjects.clear();
+        for (const auto &property_triples : lines.triples) {
+            changed_bodies_properties.insert(property_triples.first);
+            changed_heads.insert(property_triples.first);
+            for (const auto &triple : property_triples.second) {
+                appended_subjects.push_back(triple.first);
             }
         }
+        changed_heads.insert(lines.exact_cardinality_properties.begin(), lines.exact_cardinality_properties.end());
+        std::sort(appended_subjects.begin(), appended_subjects.end());
+        appended_subjects.erase(std::unique(appended_subjects.begin(), appended_subjects.end()), appended_subjects.end());
+    }
 
-        //Count the number of missing triples per relation
-        std::map<TripleStore::node_id, size_t> number_of_expected_triple_per_relation;
+    //If sample_rate < 1, the rules are first estimated on a sample of the subjects and only the ones that could
+    //be in the top k are scored exactly
+    std::vector<ScoredRule> doMining(size_t output_k_rules, size_t threads_count = 1, double sample_rate = 1) {
+        //Count number of triples per relations and number of entities
+        property_instances_count.clear();
         for (const auto property : tripleStore->getProperties()) {
-            for (TripleStore::node_id subject = 0; subject < entity_count; subject++) { //TODO: bad hack to iterate on everything
-                const auto& expected_cardinality = cardinalityStore->getExpectedCardinality(subject, property);
-                if(expected_cardinality) {
-                    auto actual_cardinality = map_has_key(tripleStore->pso[property], subject) ? tripleStore->pso[property][subject].size() : 0;
-                    if (*expected_cardinality > actual_cardinality) {
-                        number_of_expected_triple_per_relation[property] += *expected_cardinality - actual_cardinality;
-                    }
+            property_instances_count[property] = tripleStore->getRelation(property).getNumberOfTriples();
+        }
+
+        //Index the subjects with an expected cardinality and count the number of missing triples per relation
+        number_of_expected_triple_per_relation.clear();
+        expected_slots.clear();
+        for (const auto property : tripleStore->getProperties()) {
+            const auto property_triples = tripleStore->getRelation(property);
+            auto &slots = expected_slots[property];
+            for (const auto &expected_cardinality : cardinalityStore->getExpectedCardinalities(property)) {
+                const auto actual_cardinality = property_triples.getObjects(expected_cardinality.first).size();
+                //To make sure it's >= 0 in case there is an inconsistency with number of triples
+                const size_t missing = expected_cardinality.second > actual_cardinality ?
+                                       expected_cardinality.second - actual_cardinality : 0;
+                slots.push_back({expected_cardinality.first, missing});
+                if (missing > 0) {
+                    number_of_expected_triple_per_relation[property] += missing;
                 }
             }
         }
 
-        //Compute support for each possible rule and each possible body
-        std::vector<ScoredRule> rules;
-        const std::set<TripleStore::node_id> empty_entity_set;
-        for (const auto p : tripleStore->getProperties()) {
-            for (const auto q : tripleStore->getProperties()) {
-                for (const auto r : tripleStore->getProperties()) {
-
-                    ScoredRule rule(p, q, r);
-                    double pca_support = 0;
-
-                    std::map<TripleStore::node_id, size_t> facts_added_by_subject_with_cardinality;
-                    for (const auto &xy : tripleStore->pso[p]) {
-                        const auto x = xy.first;
+        //Index the relations by (subject, object), the objects of each relation with their number of subjects
+        //and the relations by subject with their number of objects
+        const std::vector<TripleStore::node_id> properties(tripleStore->getProperties().begin(), tripleStore->getProperties().end());
+        std::vector<AdjacencyIndex::Triple> pair_relations_triples;
+        std::vector<std::vector<std::pair<TripleStore::node_id, size_t>>> object_degrees(properties.size());
+        std::vector<SubjectRelation> subject_relations;
+        for (size_t i = 0; i < properties.size(); i++) {
+            std::map<TripleStore::node_id, size_t> degrees;
+            for (const auto so : tripleStore->getRelation(properties[i])) {
+                subject_relations.push_back({so.subject, i, so.objects.size()});
+                for (const auto o : so.objects) {
+                    pair_relations_triples.push_back({so.subject, o, properties[i]});
+                    degrees[o]++;
+                }
+            }
+            object_degrees[i].assign(degrees.begin(), degrees.end());
+        }
+        pair_relations = AdjacencyIndex();
+        pair_relations.build(pair_relations_triples);
+        std::sort(subject_relations.begin(), subject_relations.end());
 
-                        std::set<TripleStore::node_id> z_created;
-                        for (const auto y : xy.second) {
-                            const auto &new_z_created = map_get_value(tripleStore->pso[q], y, empty_entity_set);
-                            z_created.insert(new_z_created.begin(), new_z_created.end());
-                        }
+        //Only the bodies p(x,y) /\ q(y,z) joining on y and that could reach the minimal support are enumerated,
+        //with the upper bound of the number of (x, z) pairs they create: the sum over y of |p(_, y)| * |q(y, _)|
+        threads_count = std::max((size_t) 1, threads_count);
+        std::vector<std::pair<size_t, size_t>> bodies; //Positions of p and q in properties
+        std::vector<size_t> body_bounds;
+        for (size_t p = 0; p < properties.size(); p++) {
+            std::map<size_t, size_t> bound_by_q;
+            for (const auto &object_degree : object_degrees[p]) {
+                for (auto iter = std::lower_bound(subject_relations.begin(), subject_relations.end(),
+                                                  SubjectRelation{object_degree.first, 0, 0});
+                     iter != subject_relations.end() && iter->subject == object_degree.first; iter++) {
+                    bound_by_q[iter->property] += object_degree.second * iter->objects_count;
+                }
+            }
+            for (const auto &q_bound : bound_by_q) {
+                if (q_bound.second >= MIN_SUPPORT) {
+                    bodies.emplace_back(p, q_bound.first);
+                    body_bounds.push_back(q_bound.second);
+                }
+            }
+        }
 
-                        if (!z_created.empty()) {
-                            const auto &z_actual = map_get_value(tripleStore->pso[r], x, empty_entity_set);
-                            const auto expects_cardinality = cardinalityStore->hasExpectedCardinality(x, r);
-                            rule.body_support += z_created.size();
-                            if(!z_actual.empty()) {
-                                pca_support += z_created.size();
-                            }
-                            for(const auto z : z_created) {
-                                if(set_contains(z_actual, z)) {
-                                    rule.support++;
-                                } else if(expects_cardinality) {
-                                    facts_added_by_subject_with_cardinality[x]++;
-                                }
-                            }
-                        }
-                    }
-                    if (rule.support < MIN_SUPPORT) {
-                        continue;
+        //With sampling, the rules whose completeness confidence interval is below the k-th best lower bound are dropped.
+        //The rules without estimate, because no sampled x matches their body or head, are all scored exactly
+        std::vector<std::set<TripleStore::node_id>> pruned_heads_by_body;
+        sampled_estimates.clear();
+        if (sample_rate < 1 && output_k_rules > 0) {
+            std::vector<std::vector<RuleEstimate>> estimates_by_thread(threads_count);
+            parallel_for(bodies.size(), threads_count, [&](const size_t body, const size_t thread) {
+                estimateBody(properties[bodies[body].first], properties[bodies[body].second], body_bounds[body],
+                             sample_rate, estimates_by_thread[thread]);
+            });
+            std::vector<double> lower_bounds;
+            for (const auto &thread_estimates : estimates_by_thread) {
+                for (const auto &estimate : thread_estimates) {
+                    if (estimate.surely_passes_thresholds) {
+                        lower_bounds.push_back(estimate.lower);
                     }
+                }
+            }
+            //Without k rules surely passing the thresholds, there is no threshold and nothing is pruned
+            const bool has_threshold = lower_bounds.size() >= output_k_rules;
+            double threshold = 0;
+            if (has_threshold) {
+                std::nth_element(lower_bounds.begin(), lower_bounds.begin() + (output_k_rules - 1), lower_bounds.end(),
+                                 std::greater<double>());
+                threshold = lower_bounds[output_k_rules - 1];
+            }
 
-                    rule.head_coverage = (double) rule.support / property_instances_count[rule.r];
-                    if (rule.head_coverage < MIN_HEAD_COVERAGE) {
-                        continue;
+            const std::map<TripleStore::node_id, size_t> property_positions = getPositions(properties);
+            std::map<std::pair<size_t, size_t>, std::set<TripleStore::node_id>> pruned_heads;
+            size_t estimates_count = 0;
+            size_t pruned_count = 0;
+            for (const auto &thread_estimates : estimates_by_thread) {
+                for (const auto &estimate : thread_estimates) {
+                    estimates_count++;
+                    if (has_threshold && estimate.upper < threshold) {
+                        pruned_heads[std::make_pair(property_positions.at(estimate.p), property_positions.at(estimate.q))].insert(estimate.r);
+                        pruned_count++;
+                    } else {
+                        sampled_estimates[std::make_tuple(estimate.p, estimate.q, estimate.r)] = estimate;
                     }
+                }
+            }
+            std::cout << "sampling rate " << sample_rate << ": " << estimates_count << " rules estimated, "
+                      << pruned_count << " pruned" << std::endl;
+            for (const auto &body : bodies) {
+                pruned_heads_by_body.push_back(map_get_value(pruned_heads, body, std::set<TripleStore::node_id>()));
+            }
+        }
 
-                    rule.standard_confidence = (double) rule.support / rule.body_support;
-                    if (rule.standard_confidence < MIN_STANDARD_CONFIDENCE) {
-                        continue;
-                    }
+        //Compute support for each body joining on y and each head sharing enough (x, z) pairs with it.
+        //The workers take the (p, q) bodies one after the other and score them with their possible heads.
+        //Each worker keeps its own top rules and they are merged at the end. The ranking being a total order,
+        //the output does not depend on the number of threads.
+        //With the counters of a previous run, the bodies without appended triples only update the changed heads
+        std::vector<TopScoredRules> top_rules_by_thread(threads_count, TopScoredRules(output_k_rules));
+        std::vector<MiningCounters> counters_by_thread(recorded_counters == nullptr ? 0 : threads_count);
+        parallel_for(bodies.size(), threads_count, [&](const size_t body, const size_t thread) {
+            const auto p = properties[bodies[body].first];
+            const auto q = properties[bodies[body].second];
+            const bool reuse = previous_counters != nullptr &&
+                               !set_contains(changed_bodies_properties, p) && !set_contains(changed_bodies_properties, q);
+            const std::set<TripleStore::node_id> *pruned_heads = pruned_heads_by_body.empty() ? nullptr : &pruned_heads_by_body[body];
+            MiningCounters *recorded = recorded_counters == nullptr ? nullptr : &counters_by_thread[thread];
+            const auto known_body_support = reuse ?
+                    map_get_value(previous_counters->body_supports, std::make_pair(p, q)) :
+                    std::experimental::optional<size_t>();
+            if (known_body_support) {
+                updateBody(p, q, *known_body_support, top_rules_by_thread[thread], recorded);
+            } else {
+                scoreBody(p, q, top_rules_by_thread[thread], reuse ? &changed_heads : nullptr, pruned_heads, recorded);
+            }
 
-                    rule.pca_confidence = (double) rule.support / pca_support;
-
-                    size_t triple_added_to_missing_places_count = 0;
-                    size_t triple_added_to_complete_places_count = 0;
-                    for (const auto &t : facts_added_by_subject_with_cardinality) {
-                        auto expected_cardinality = cardinalityStore->getExpectedCardinality(t.first, rule.r);
-                        if (expected_cardinality) {
-                            size_t actual_triples_number = tripleStore->pso[rule.r][t.first].size();
-                            size_t missing_triples = 0;
-                            if (*expected_cardinality > actual_triples_number) {
-                                //To make sure it's >= 0 in case there is an inconsistency with number of triples
-                                missing_triples = *expected_cardinality - actual_triples_number;
-                            }
-                            size_t triples_added_by_the_rule = t.second;
-                            if (triples_added_by_the_rule > missing_triples) {
-                                triple_added_to_missing_places_count += missing_triples;
-                                triple_added_to_complete_places_count += triples_added_by_the_rule - missing_triples;
-                            } else {
-                                triple_added_to_missing_places_count += triples_added_by_the_rule;
-                            }
-                        } else {
-                            std::cout << "Warning: stored added facts where no cardinality exists" << std::endl;
-                        }
+            if (reuse) {
+                const auto &previous_rules = previous_counters->rules;
+                for (auto iter = previous_rules.lower_bound(std::make_tuple(p, q, (TripleStore::node_id) 0));
+                     iter != previous_rules.end() && std::get<0>(iter->first) == p && std::get<1>(iter->first) == q; iter++) {
+                    const auto r = std::get<2>(iter->first);
+                    if (!set_contains(changed_heads, r) && map_has_key(property_instances_count, r)) {
+                        ScoredRule rule(p, q, r);
+                        finishRule(rule, iter->second);
+                        pushRule(rule, iter->second, top_rules_by_thread[thread], recorded);
                     }
+                }
+            }
+        });
+        if (recorded_counters != nullptr) {
+            recorded_counters->rules.clear();
+            recorded_counters->body_supports.clear();
+            for (const auto &thread_counters : counters_by_thread) {
+                recorded_counters->rules.insert(thread_counters.rules.begin(), thread_counters.rules.end());
+                recorded_counters->body_supports.insert(thread_counters.body_supports.begin(),
+                                                        thread_counters.body_supports.end());
+            }
+        }
+
+        TopScoredRules top_rules(output_k_rules);
+        for (const auto &thread_top_rules : top_rules_by_thread) {
+            for (const auto &rule : thread_top_rules.sorted()) {
+                top_rules.push(rule);
+            }
+        }
+        std::cout << std::endl;
+        const auto result = top_rules.sorted();
+        if (!sampled_estimates.empty()) {
+            reportSamplingError(result);
+        }
+        std::cout << "starting output" << std::endl;
+        return result;
+    }
 
-                    rule.completeness_confidence = rule.support / (double) (rule.body_support - triple_added_to_missing_places_count);
+private:
+    //A subject of a relation with its number of objects
+    struct SubjectRelation {
+        TripleStore::node_id subject;
+        size_t property; //Position in the properties
+        size_t objects_count;
 
-                    rule.precision = 1 - (double) triple_added_to_complete_places_count / rule.body_support;
-                    if (number_of_expected_triple_per_relation[rule.r]) {
-                        rule.recall = (double) triple_added_to_missing_places_count / number_of_expected_triple_per_relation[rule.r];
-                    } else {
-                        rule.recall = std::numeric_limits<double>::quiet_NaN();
-                    }
-                    if (triple_added_to_complete_places_count + triple_added_to_missing_places_count) {
-                        rule.directional_metric =
-                                ((double) triple_added_to_missing_places_count - triple_added_to_complete_places_count) /
-                                        (2 * (triple_added_to_missing_places_count + triple_added_to_complete_places_count)) + 0.5;
-                    } else {
-                        rule.directional_metric = std::numeric_limits<double>::quiet_NaN();
+        inline bool operator<(const SubjectRelation &other) const {
+            return subject < other.subject || (subject == other.subject && property < other.property);
+        }
+    };
+
+    struct RuleEstimate {
+        TripleStore::node_id p;
+        TripleStore::node_id q;
+        TripleStore::node_id r;
+        double completeness_confidence;
+        double lower;
+        double upper;
+        bool surely_passes_thresholds;
+    };
+
+    static std::map<TripleStore::node_id, size_t> getPositions(const std::vector<TripleStore::node_id> &properties) {
+        std::map<TripleStore::node_id, size_t> positions;
+        for (size_t i = 0; i < properties.size(); i++) {
+            positions[properties[i]] = i;
+        }
+        return positions;
+    }
+
+    //Compares the estimates of the output rules with their exact values
+    void reportSamplingError(const std::vector<ScoredRule> &rules) const {
+        double error_sum = 0;
+        size_t estimated = 0;
+        size_t in_interval = 0;
+        for (const auto &rule : rules) {
+            const auto iter = sampled_estimates.find(std::make_tuple(rule.p, rule.q, rule.r));
+            if (iter == sampled_estimates.end()) {
+                continue;
+            }
+            const auto &estimate = iter->second;
+            estimated++;
+            error_sum += std::abs(estimate.completeness_confidence - rule.completeness_confidence);
+            if (estimate.lower <= rule.completeness_confidence && rule.completeness_confidence <= estimate.upper) {
+                in_interval++;
+            }
+        }
+        if (estimated > 0) {
+            std::cout << "sampling error on the " << estimated << " estimated output rules (" << rules.size() - estimated
+                      << " without estimate): mean absolute error of the completeness confidence "
+                      << error_sum / estimated << ", " << (100. * in_interval / estimated)
+                      << "% of the exact values in the " << CONFIDENCE_INTERVAL_LEVEL << "% confidence intervals" << std::endl;
+        }
+    }
+
+    //Counters of a head r for the body p(x,y) /\ q(y,z)
+    struct HeadCounters {
+        Relation r_triples;
+        ExpectedSlotsCursor r_slots;
+        size_t pca_support = 0;
+        size_t triple_added_to_missing_places_count = 0;
+        size_t triple_added_to_complete_places_count = 0;
+    };
+
+    static void pushRule(const ScoredRule &rule, const RuleCounters &counters, TopScoredRules &top_rules,
+                         MiningCounters *recorded) {
+        top_rules.push(rule);
+        if (recorded != nullptr) {
+            recorded->rules[std::make_tuple(rule.p, rule.q, rule.r)] = counters;
+        }
+    }
+
+    //The sorted x that are subjects of the heads or have an expected cardinality for them
+    std::vector<TripleStore::node_id> getHeadsSubjects(const std::set<TripleStore::node_id> &heads) const {
+        std::vector<TripleStore::node_id> subjects;
+        for (const auto r : heads) {
+            const auto r_subjects = tripleStore->getRelation(r).getSubjects();
+            subjects.insert(subjects.end(), r_subjects.begin(), r_subjects.end());
+            const auto r_slots = expected_slots.find(r);
+            if (r_slots != expected_slots.end()) {
+                for (const auto &slot : r_slots->second) {
+                    subjects.push_back(slot.subject);
+                }
+            }
+        }
+        std::sort(subjects.begin(), subjects.end());
+        subjects.erase(std::unique(subjects.begin(), subjects.end()), subjects.end());
+        return subjects;
+    }
+
+    //The p o q composition: the x with their sorted z, and the number of (x, z) pairs of each relation r
+    struct Composition {
+        std::vector<TripleStore::node_id> x_values;
+        std::vector<size_t> z_offsets = {0};
+        std::vector<TripleStore::node_id> z_values;
+        std::map<TripleStore::node_id, size_t> support_by_head;
+    };
+
+    //Only the x in the sample of the given rate and, if x_subset is set, in this sorted vector are considered.
+    //The body is evaluated by the join engine in the order x, y, z: the y of each x are the intersection of its
+    //p objects with the q subjects, and the z of each x are then sorted and deduplicated
+    Composition composeBody(const TripleStore::node_id p, const TripleStore::node_id q, const double sample_rate,
+                            const std::vector<TripleStore::node_id> *x_subset = nullptr) const {
+        const variable_id X = 0, Y = 1, Z = 2;
+        const ConjunctiveQuery query(*tripleStore, {{p, X, Y}, {q, Y, Z}}, {X, Y, Z});
+
+        Composition composition;
+        auto &z_values = composition.z_values;
+        const auto add_x = [&](const TripleStore::node_id x) {
+            const size_t z_begin = composition.z_offsets.back();
+            std::sort(z_values.begin() + z_begin, z_values.end());
+            z_values.erase(std::unique(z_values.begin() + z_begin, z_values.end()), z_values.end());
+            composition.x_values.push_back(x);
+            composition.z_offsets.push_back(z_values.size());
+
+            const auto x_relations = pair_relations.get(x);
+            for (size_t i = z_begin; i < z_values.size(); i++) {
+                for (const auto r : x_relations.getObjects(z_values[i])) {
+                    composition.support_by_head[r]++;
+                }
+            }
+        };
+        bool has_x = false;
+        TripleStore::node_id current_x = 0;
+        query.forEach(3, [&](const variable_id variable, const TripleStore::node_id value) {
+            return variable != X || ((sample_rate >= 1 || isInSample(value, sample_rate)) &&
+                                     (x_subset == nullptr || std::binary_search(x_subset->begin(), x_subset->end(), value)));
+        }, [&](const ConjunctiveQuery::Values &values) {
+            if (has_x && values[X] != current_x) {
+                add_x(current_x);
+            }
+            has_x = true;
+            current_x = values[X];
+            z_values.push_back(values[Z]);
+        });
+        if (has_x) {
+            add_x(current_x);
+        }
+        return composition;
+    }
+
+    //Deterministic uniform sample of the subjects, the same for all the bodies
+    static inline bool isInSample(const TripleStore::node_id x, const double sample_rate) {
+        return (uint32_t) (x * 2654435761u) < sample_rate * 4294967296.;
+    }
+
+    //Estimates the completeness confidence of the rules p(x,y) /\ q(y,z) -> r(x,z) on the sampled x.
+    //The ratio estimator and its variance are computed with each x as a cluster of (x, z) pairs
+    void estimateBody(const TripleStore::node_id p, const TripleStore::node_id q, const size_t body_bound,
+                      const double sample_rate, std::vector<RuleEstimate> &estimates) const {
+        const auto composition = composeBody(p, q, sample_rate);
+        const size_t n = composition.x_values.size();
+
+        for (const auto &head_support : composition.support_by_head) {
+            const auto r = head_support.first;
+            const auto r_triples = tripleStore->getRelation(r);
+            ExpectedSlotsCursor r_slots(expected_slots.at(r));
+            //Sums over the sampled x of the support a and of the body size without the filled missing places b
+            double a_sum = 0, b_sum = 0, aa_sum = 0, bb_sum = 0, ab_sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                const auto x = composition.x_values[i];
+                const IdRange z_created(composition.z_values.data() + composition.z_offsets[i],
+                                        composition.z_values.data() + composition.z_offsets[i + 1]);
+                const auto z_actual = r_triples.getObjects(x);
+                size_t support = 0;
+                for (const auto z : z_created) {
+                    if (z_actual.contains(z)) {
+                        support++;
                     }
+                }
+                size_t filled_missing_places = 0;
+                const auto slot = r_slots.find(x);
+                if (slot != nullptr) {
+                    filled_missing_places = std::min(z_created.size() - support, slot->missing);
+                }
+                const double a = support;
+                const double b = z_created.size() - filled_missing_places;
+                a_sum += a;
+                b_sum += b;
+                aa_sum += a * a;
+                bb_sum += b * b;
+                ab_sum += a * b;
+            }
 
-                    double possible_relations_num = entity_count*entity_count;
-                    double expected_incomplete = number_of_expected_triple_per_relation[rule.r] / possible_relations_num;
-                    double expected_complete = (possible_relations_num - number_of_expected_triple_per_relation[rule.r] - property_instances_count[rule.r]) / possible_relations_num;
-                    double actual_complete = (double) triple_added_to_complete_places_count / rule.body_support;
-                    double actual_incomplete = (double) triple_added_to_missing_places_count / rule.body_support;
-                    if(actual_complete == 0 || expected_incomplete == 0) {
-                        rule.directional_coef = std::numeric_limits<float>::max();
-                    } else {
-                        rule.directional_coef = 0.5 * expected_complete / actual_complete + 0.5 * actual_incomplete / expected_incomplete;
+            RuleEstimate estimate;
+            estimate.p = p;
+            estimate.q = q;
+            estimate.r = r;
+            estimate.completeness_confidence = b_sum > 0 ? a_sum / b_sum : 0;
+            estimate.lower = 0;
+            estimate.upper = 1;
+            if (n >= 2 && b_sum > 0) {
+                const double ratio = estimate.completeness_confidence;
+                const double mean_b = b_sum / n;
+                const double residuals = std::max(0., aa_sum - 2 * ratio * ab_sum + ratio * ratio * bb_sum);
+                const double variance = (1 - sample_rate) * residuals / ((n - 1) * n * mean_b * mean_b);
+                const double margin = CONFIDENCE_INTERVAL_Z * std::sqrt(variance);
+                //The Wilson score interval of the b_sum sampled pairs does not collapse when the support or the
+                //residuals are 0. The union of the two intervals is used
+                const double z2 = CONFIDENCE_INTERVAL_Z * CONFIDENCE_INTERVAL_Z;
+                const double wilson_center = (ratio + z2 / (2 * b_sum)) / (1 + z2 / b_sum);
+                const double wilson_margin = CONFIDENCE_INTERVAL_Z / (1 + z2 / b_sum) *
+                                             std::sqrt(ratio * (1 - ratio) / b_sum + z2 / (4 * b_sum * b_sum));
+                estimate.lower = std::max(0., std::min(ratio - margin, wilson_center - wilson_margin));
+                estimate.upper = std::min(1., std::max(ratio + margin, wilson_center + wilson_margin));
+            }
+            //The sampled counts are lower bounds of the exact ones
+            estimate.surely_passes_thresholds = head_support.second >= MIN_SUPPORT &&
+                    (double) head_support.second / property_instances_count.at(r) >= MIN_HEAD_COVERAGE &&
+                    (double) head_support.second / body_bound >= MIN_STANDARD_CONFIDENCE;
+            estimates.push_back(estimate);
+        }
+    }
+
+    //Appends the rules p(x,y) /\ q(y,z) -> r(x,z) passing the thresholds to rules, in head order.
+    //If heads is set, only these heads are considered. The pruned_heads are not considered.
+    //If recorded is set, the counters of all the rules passing the thresholds and the body support are added to it
+    //and no rule is skipped because of the top rules.
+    //If x_subset is set, only its x are composed and body_support is the number of (x, z) pairs of the whole body:
+    //the heads should only have subjects and expected cardinalities in x_subset.
+    //The body is computed once and its heads are then scored together. Only reads the stores
+    void scoreBody(const TripleStore::node_id p, const TripleStore::node_id q, TopScoredRules &top_rules,
+                   const std::set<TripleStore::node_id> *heads = nullptr,
+                   const std::set<TripleStore::node_id> *pruned_heads = nullptr, MiningCounters *recorded = nullptr,
+                   const std::vector<TripleStore::node_id> *x_subset = nullptr, size_t body_support = 0) const {
+        const auto composition = composeBody(p, q, 1, x_subset);
+        const auto &x_values = composition.x_values;
+        const auto &z_offsets = composition.z_offsets;
+        const auto &z_values = composition.z_values;
+        if (x_subset == nullptr) {
+            body_support = z_values.size();
+        }
+        if (recorded != nullptr) {
+            recorded->body_supports[std::make_pair(p, q)] = body_support;
+        }
+
+        std::vector<ScoredRule> head_rules;
+        std::vector<HeadCounters> head_counters;
+        for (const auto &head_support : composition.support_by_head) {
+            if ((heads != nullptr && !set_contains(*heads, head_support.first)) ||
+                (pruned_heads != nullptr && set_contains(*pruned_heads, head_support.first))) {
+                continue;
+            }
+            ScoredRule rule(p, q, head_support.first);
+            rule.support = head_support.second;
+            rule.body_support = body_support;
+            if (rule.support < MIN_SUPPORT) {
+                continue;
+            }
+
+            rule.head_coverage = (double) rule.support / property_instances_count.at(rule.r);
+            if (rule.head_coverage < MIN_HEAD_COVERAGE) {
+                continue;
+            }
+
+            rule.standard_confidence = (double) rule.support / rule.body_support;
+            if (rule.standard_confidence < MIN_STANDARD_CONFIDENCE) {
+                continue;
+            }
+
+            //At best all the added facts fill missing places
+            if (recorded == nullptr && top_rules.isFull()) {
+                const size_t NO_COUNT = 0;
+                const size_t max_missing_places = std::min(rule.body_support - rule.support,
+                                                           map_get_value(number_of_expected_triple_per_relation, rule.r, NO_COUNT));
+                const double max_completeness_confidence = rule.support / (double) (rule.body_support - max_missing_places);
+                if (max_completeness_confidence < top_rules.worst().completeness_confidence) {
+                    continue;
+                }
+            }
+
+            head_rules.push_back(rule);
+            head_counters.push_back({tripleStore->getRelation(rule.r), ExpectedSlotsCursor(expected_slots.at(rule.r))});
+        }
+        if (head_rules.empty()) {
+            return;
+        }
+
+        //A single pass on the composition updates the counters of all the heads
+        for (size_t i = 0; i < x_values.size(); i++) {
+            const auto x = x_values[i];
+            const IdRange z_created(z_values.data() + z_offsets[i], z_values.data() + z_offsets[i + 1]);
+            for (size_t h = 0; h < head_rules.size(); h++) {
+                auto &counters = head_counters[h];
+                const auto z_actual = counters.r_triples.getObjects(x);
+                if (!z_actual.empty()) {
+                    counters.pca_support += z_created.size();
+                }
+                const auto slot = counters.r_slots.find(x);
+                if (slot == nullptr) {
+                    continue;
+                }
+                size_t triples_added_by_the_rule = 0;
+                for (const auto z : z_created) {
+                    if (!z_actual.contains(z)) {
+                        triples_added_by_the_rule++;
                     }
+                }
+                if (triples_added_by_the_rule == 0) {
+                    continue;
+                }
+                const size_t missing_triples = slot->missing;
+                if (triples_added_by_the_rule > missing_triples) {
+                    counters.triple_added_to_missing_places_count += missing_triples;
+                    counters.triple_added_to_complete_places_count += triples_added_by_the_rule - missing_triples;
+                } else {
+                    counters.triple_added_to_missing_places_count += triples_added_by_the_rule;
+                }
+            }
+        }
+
+        for (size_t h = 0; h < head_rules.size(); h++) {
+            const RuleCounters counters = {head_rules[h].support, head_rules[h].body_support, head_counters[h].pca_support,
+                                           head_counters[h].triple_added_to_missing_places_count,
+                                           head_counters[h].triple_added_to_complete_places_count};
+            finishRule(head_rules[h], counters);
+            pushRule(head_rules[h], counters, top_rules, recorded);
+            std::cout << '*' << std::flush;
+        }
+    }
+
+    //Adds to counters the contribution of x to the counters of the rule p(x,y) /\ q(y,z) -> r(x,z), given the z created
+    //by the body for x, the z such that r(x, z) and the expected cardinality of r for x. The body support is not counted
+    static void addSubjectCounters(const IdRange &z_created, const IdRange &z_actual,
+                                   const std::experimental::optional<size_t> &expected_cardinality, RuleCounters &counters) {
+        size_t support = 0;
+        for (const auto z : z_created) {
+            if (z_actual.contains(z)) {
+                support++;
+            }
+        }
+        counters.support += support;
+        if (!z_actual.empty()) {
+            counters.pca_support += z_created.size();
+        }
+        if (!expected_cardinality) {
+            return;
+        }
+        const size_t triples_added_by_the_rule = z_created.size() - support;
+        const size_t missing_triples = *expected_cardinality > z_actual.size() ? *expected_cardinality - z_actual.size() : 0;
+        counters.triple_added_to_missing_places_count += std::min(triples_added_by_the_rule, missing_triples);
+        if (triples_added_by_the_rule > missing_triples) {
+            counters.triple_added_to_complete_places_count += triples_added_by_the_rule - missing_triples;
+        }
+    }
+
+    inline bool passesThresholds(const RuleCounters &counters, const TripleStore::node_id r) const {
+        return counters.support >= MIN_SUPPORT &&
+               (double) counters.support / property_instances_count.at(r) >= MIN_HEAD_COVERAGE &&
+               (double) counters.support / counters.body_support >= MIN_STANDARD_CONFIDENCE;
+    }
 
-                    rules.push_back(rule);
+    //Updates from the previous counters the rules p(x,y) /\ q(y,z) -> r(x,z) of a body without appended triples whose
+    //head has appended triples. Only the counters of the subjects of the appended triples change: they are computed
+    //again with the objects of the head before the append, its current ones without the appended ones.
+    //The heads with appended exact cardinalities and the rules without previous counters whose support increases
+    //are scored again on the subjects of the head. Only reads the stores
+    void updateBody(const TripleStore::node_id p, const TripleStore::node_id q, const size_t body_support,
+                    TopScoredRules &top_rules, MiningCounters *recorded) const {
+        if (recorded != nullptr) {
+            recorded->body_supports[std::make_pair(p, q)] = body_support;
+        }
+        std::set<TripleStore::node_id> rescored_heads = appended_lines->exact_cardinality_properties;
+        const auto composition = composeBody(p, q, 1, &appended_subjects);
+        std::vector<TripleStore::node_id> previous_objects;
+        for (const auto &head_triples : appended_lines->triples) {
+            const auto r = head_triples.first;
+            if (set_contains(rescored_heads, r)) {
+                continue;
+            }
+            const auto &triples = head_triples.second;
+            const auto r_triples = tripleStore->getRelation(r);
+            RuleCounters previous_subjects_counters = {0, 0, 0, 0, 0};
+            RuleCounters current_subjects_counters = {0, 0, 0, 0, 0};
+            for (size_t i = 0; i < composition.x_values.size(); i++) {
+                const auto x = composition.x_values[i];
+                auto iter = std::lower_bound(triples.begin(), triples.end(), std::make_pair(x, (TripleStore::node_id) 0));
+                if (iter == triples.end() || iter->first != x) {
+                    continue;
+                }
+                const IdRange z_created(composition.z_values.data() + composition.z_offsets[i],
+                                        composition.z_values.data() + composition.z_offsets[i + 1]);
+                const auto z_actual = r_triples.getObjects(x);
+                previous_objects.clear();
+                for (const auto z : z_actual) {
+                    while (iter != triples.end() && iter->first == x && iter->second < z) {
+                        iter++;
+                    }
+                    if (iter == triples.end() || iter->first != x || iter->second != z) {
+                        previous_objects.push_back(z);
+                    }
+                }
+                const auto expected_cardinality = cardinalityStore->getExpectedCardinality(x, r);
+                addSubjectCounters(z_created, IdRange(previous_objects.data(), previous_objects.data() + previous_objects.size()),
+                                   expected_cardinality, previous_subjects_counters);
+                addSubjectCounters(z_created, z_actual, expected_cardinality, current_subjects_counters);
+            }
 
-                    std::cout << '*' << std::flush;
+            const auto previous = previous_counters->rules.find(std::make_tuple(p, q, r));
+            if (previous == previous_counters->rules.end()) {
+                //The rule did not pass the thresholds, it could now
+                if (current_subjects_counters.support > previous_subjects_counters.support) {
+                    rescored_heads.insert(r);
                 }
+                continue;
+            }
+            RuleCounters counters = previous->second;
+            counters.support += current_subjects_counters.support - previous_subjects_counters.support;
+            counters.pca_support += current_subjects_counters.pca_support - previous_subjects_counters.pca_support;
+            counters.triple_added_to_missing_places_count += current_subjects_counters.triple_added_to_missing_places_count -
+                                                             previous_subjects_counters.triple_added_to_missing_places_count;
+            counters.triple_added_to_complete_places_count += current_subjects_counters.triple_added_to_complete_places_count -
+                                                              previous_subjects_counters.triple_added_to_complete_places_count;
+            if (passesThresholds(counters, r)) {
+                ScoredRule rule(p, q, r);
+                finishRule(rule, counters);
+                pushRule(rule, counters, top_rules, recorded);
             }
         }
-        std::cout << std::endl << "starting output" << std::endl;
 
-        std::sort(rules.begin(), rules.end(),
-                  [](const ScoredRule &a, const ScoredRule &b) {
-                      return a.completeness_confidence > b.completeness_confidence;
-                  });
+        if (!rescored_heads.empty()) {
+            const auto subjects = getHeadsSubjects(rescored_heads);
+            scoreBody(p, q, top_rules, &rescored_heads, nullptr, recorded, &subjects, body_support);
+        }
+    }
+
+    //Computes the metrics of the rule from its counters
+    void finishRule(ScoredRule &rule, const RuleCounters &counters) const {
+        rule.support = counters.support;
+        rule.body_support = counters.body_support;
+        rule.head_coverage = (double) rule.support / property_instances_count.at(rule.r);
+        rule.standard_confidence = (double) rule.support / rule.body_support;
+
+        const size_t NO_COUNT = 0;
+        const size_t expected_triples_count = map_get_value(number_of_expected_triple_per_relation, rule.r, NO_COUNT);
+        const size_t triple_added_to_missing_places_count = counters.triple_added_to_missing_places_count;
+        const size_t triple_added_to_complete_places_count = counters.triple_added_to_complete_places_count;
 
-        size_t limit = std::min(output_k_rules, rules.size());
-        std::vector<ScoredRule> result;
-        for (size_t j = 0; j < limit; j++) {
-            result.push_back(rules[j]);
+        rule.pca_confidence = (double) rule.support / (double) counters.pca_support;
+        rule.completeness_confidence = rule.support / (double) (rule.body_support - triple_added_to_missing_places_count);
+
+        rule.precision = 1 - (double) triple_added_to_complete_places_count / rule.body_support;
+        if (expected_triples_count) {
+            rule.recall = (double) triple_added_to_missing_places_count / expected_triples_count;
+        } else {
+            rule.recall = std::numeric_limits<double>::quiet_NaN();
+        }
+        if (triple_added_to_complete_places_count + triple_added_to_missing_places_count) {
+            rule.directional_metric =
+                    ((double) triple_added_to_missing_places_count - triple_added_to_complete_places_count) /
+                            (2 * (triple_added_to_missing_places_count + triple_added_to_complete_places_count)) + 0.5;
+        } else {
+            rule.directional_metric = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        double possible_relations_num = entity_count*entity_count;
+        double expected_incomplete = expected_triples_count / possible_relations_num;
+        double expected_complete = (possible_relations_num - expected_triples_count - property_instances_count.at(rule.r)) / possible_relations_num;
+        double actual_complete = (double) triple_added_to_complete_places_count / rule.body_support;
+        double actual_incomplete = (double) triple_added_to_missing_places_count / rule.body_support;
+        if(actual_complete == 0 || expected_incomplete == 0) {
+            rule.directional_coef = std::numeric_limits<float>::max();
+        } else {
+            rule.directional_coef = 0.5 * expected_complete / actual_complete + 0.5 * actual_incomplete / expected_incomplete;
         }
-        return result;
     }
 
-private:
     std::shared_ptr<TripleStore> tripleStore;
     std::shared_ptr<CardinalitiesStore> cardinalityStore;
+    size_t entity_count;
+    std::map<TripleStore::node_id, size_t> property_instances_count;
+    std::map<TripleStore::node_id, size_t> number_of_expected_triple_per_relation;
+    //For each relation, its subjects with an expected cardinality, sorted
+    std::map<TripleStore::node_id, std::vector<ExpectedSlot>> expected_slots;
+    std::map<std::tuple<TripleStore::node_id, TripleStore::node_id, TripleStore::node_id>, RuleEstimate> sampled_estimates;
+    MiningCounters *recorded_counters = nullptr;
+    const MiningCounters *previous_counters = nullptr;
+    const AppendedLines *appended_lines = nullptr;
+    std::set<TripleStore::node_id> changed_bodies_properties; //With appended triples
+    std::set<TripleStore::node_id> changed_heads; //With appended triples or exact cardinalities
+    std::vector<TripleStore::node_id> appended_subjects; //Subjects of the appended triples, sorted
+    //x -> z -> relations r such that r(x, z)
+    AdjacencyIndex pair_relations;
 };
 
-double evaluate_rule(const ScoredRule& rule, std::shared_ptr<TripleStore> train_triples, std::shared_ptr<TripleStore> eval_triples) {
-    size_t rule_support = 0;
-    size_t body_support = 0;
-    for (auto &xy : train_triples->pso[rule.p]) {
-        const auto x = xy.first;
-        std::set<TripleStore::node_id> z_created;
-        for(const auto y : xy.second) {
-            const auto& z_add = train_triples->pso[rule.q][y];
-            z_created.insert(z_add.begin(), z_add.end());
-        }
-        for(const auto z : z_created) {
-            if(!train_triples->contains(x, rule.r, z)) {
-                if(eval_triples->contains(train_triples->getNodeForId(x), train_triples->getNodeForId(rule.r), train_triples->getNodeForId(z))) {
-                    rule_support++;
+//Returns for each rule the ratio of the facts it adds to train_triples that are in eval_triples.
+//The rules sharing the same body are evaluated together. train_triples and eval_triples should share the same dictionary
+std::vector<double> evaluate_rules(const std::vector<ScoredRule> &rules, std::shared_ptr<TripleStore> train_triples,
+                                   std::shared_ptr<TripleStore> eval_triples, const size_t threads_count) {
+    std::map<std::pair<TripleStore::node_id, TripleStore::node_id>, std::vector<size_t>> rules_by_body;
+    for (size_t i = 0; i < rules.size(); i++) {
+        rules_by_body[std::make_pair(rules[i].p, rules[i].q)].push_back(i);
+    }
+    const std::vector<std::pair<std::pair<TripleStore::node_id, TripleStore::node_id>, std::vector<size_t>>> bodies(
+            rules_by_body.begin(), rules_by_body.end());
+
+    std::vector<double> evaluations(rules.size());
+    parallel_for(bodies.size(), std::max((size_t) 1, threads_count), [&](const size_t body, size_t) {
+        const auto p_triples = train_triples->getRelation(bodies[body].first.first);
+        const auto q_triples = train_triples->getRelation(bodies[body].first.second);
+        const auto &body_rules = bodies[body].second;
+        std::vector<Relation> r_train_triples;
+        std::vector<Relation> r_eval_triples;
+        for (const auto rule : body_rules) {
+            r_train_triples.push_back(train_triples->getRelation(rules[rule].r));
+            r_eval_triples.push_back(eval_triples->getRelation(rules[rule].r));
+        }
+        std::vector<size_t> rule_support(body_rules.size(), 0);
+        std::vector<size_t> body_support(body_rules.size(), 0);
+
+        std::vector<TripleStore::node_id> z_created;
+        for (const auto xy : p_triples) {
+            const auto x = xy.subject;
+            z_created.clear();
+            for (const auto y : xy.objects) {
+                const auto z_add = q_triples.getObjects(y);
+                z_created.insert(z_created.end(), z_add.begin(), z_add.end());
+            }
+            std::sort(z_created.begin(), z_created.end());
+            z_created.erase(std::unique(z_created.begin(), z_created.end()), z_created.end());
+            for (size_t i = 0; i < body_rules.size(); i++) {
+                const auto z_train = r_train_triples[i].getObjects(x);
+                const auto z_eval = r_eval_triples[i].getObjects(x);
+                for (const auto z : z_created) {
+                    if (!z_train.contains(z)) {
+                        if (z_eval.contains(z)) {
+                            rule_support[i]++;
+                        }
+                        body_support[i]++;
+                    }
                 }
-                body_support++;
             }
         }
+        for (size_t i = 0; i < body_rules.size(); i++) {
+            evaluations[body_rules[i]] = (double) rule_support[i] / (double) body_support[i];
+        }
+    });
+    return evaluations;
+}
+
+//Writes the counters as TSV lines p q r support body_support pca_support missing_places complete_places
+//for the rules and p q body_support for the bodies
+void save_mining_counters(const std::string &file_name, const MiningCounters &counters, const TripleStore &triple_store) {
+    std::ofstream stream(file_name);
+    if (!stream.is_open()) {
+        throw std::runtime_error(file_name + " is not writable.");
+    }
+    for (const auto &rule : counters.rules) {
+        stream << triple_store.getNodeForId(std::get<0>(rule.first)) << '\t'
+               << triple_store.getNodeForId(std::get<1>(rule.first)) << '\t'
+               << triple_store.getNodeForId(std::get<2>(rule.first)) << '\t'
+               << rule.second.support << '\t' << rule.second.body_support << '\t' << rule.second.pca_support << '\t'
+               << rule.second.triple_added_to_missing_places_count << '\t'
+               << rule.second.triple_added_to_complete_places_count << '\n';
+    }
+    for (const auto &body : counters.body_supports) {
+        stream << triple_store.getNodeForId(body.first.first) << '\t' << triple_store.getNodeForId(body.first.second)
+               << '\t' << body.second << '\n';
+    }
+}
+
+//Reads the counters written by save_mining_counters. The lines with properties unknown to the store are skipped
+MiningCounters load_mining_counters(const std::string &file_name, const TripleStore &triple_store) {
+    std::ifstream stream(file_name);
+    if (!stream.is_open()) {
+        throw std::runtime_error(file_name + " is not readable.");
+    }
+    const auto &dictionary = *triple_store.getDictionary();
+    MiningCounters counters;
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::vector<std::string> fields;
+        std::istringstream line_stream(line);
+        std::string field;
+        while (std::getline(line_stream, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() == 3) {
+            const auto p = dictionary.findIdForNode(fields[0]);
+            const auto q = dictionary.findIdForNode(fields[1]);
+            if (p && q) {
+                counters.body_supports[std::make_pair(*p, *q)] = std::stoul(fields[2]);
+            }
+            continue;
+        }
+        if (fields.size() != 8) {
+            throw std::runtime_error("invalid rule counters line in " + file_name + ": " + line);
+        }
+        const auto p = dictionary.findIdForNode(fields[0]);
+        const auto q = dictionary.findIdForNode(fields[1]);
+        const auto r = dictionary.findIdForNode(fields[2]);
+        if (p && q && r) {
+            counters.rules[std::make_tuple(*p, *q, *r)] = {std::stoul(fields[3]), std::stoul(fields[4]), std::stoul(fields[5]),
+                                                           std::stoul(fields[6]), std::stoul(fields[7])};
+        }
+    }
+    return counters;
+}
+
+//Reads the triples and the exact cardinalities of the file whose nodes are known to the store.
+//The other cardinality statements are not used by the mining
+AppendedLines read_appended_lines(const std::string &file_name, const TripleStore &triple_store) {
+    const auto &dictionary = *triple_store.getDictionary();
+    MappedFile file(file_name);
+    AppendedLines lines;
+    const char *cursor = file.data();
+    const char *end = file.data() + file.size();
+    std::experimental::string_view s, p, o;
+    while (cursor != end) {
+        if (!read_triple_line(cursor, end, s, p, o)) {
+            continue;
+        }
+        if (p == "hasAtLeastCardinality" || p == "hasAtMostCardinality") {
+            continue;
+        }
+        if (p == "hasExactCardinality") {
+            const auto separator = s.find('|');
+            if (separator == std::experimental::string_view::npos) {
+                continue;
+            }
+            const auto property = dictionary.findIdForNode(s.substr(separator + 1));
+            if (property) {
+                lines.exact_cardinality_properties.insert(*property);
+            }
+            continue;
+        }
+        const auto subject = dictionary.findIdForNode(s);
+        const auto property = dictionary.findIdForNode(p);
+        const auto object = dictionary.findIdForNode(o);
+        if (subject && property && object) {
+            lines.triples[*property].emplace_back(*subject, *object);
+        }
+    }
+    for (auto &property_triples : lines.triples) {
+        auto &triples = property_triples.second;
+        std::sort(triples.begin(), triples.end());
+        triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
     }
-    return (double) rule_support / (double) body_support;
+    return lines;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 5) {
-        std::cerr << argv[0] << " input_triples.tsv input_cardinalities.tsv evaluation_triples.tsv output.tsv" << std::endl;
+    CommandLine command_line(argc, argv);
+    const auto &arguments = command_line.getArguments();
+    const bool use_snapshot = command_line.hasOption("snapshot");
+    if (arguments.size() < (use_snapshot ? 2 : 4)) {
+        std::cerr << argv[0] << " [--threads N] [--sample-rate R] [--counters rules.counters [--delta appended.tsv]] [--predicates P1,P2] [--subjects subjects.txt] [--strip-prefixes PREFIX1,PREFIX2] input_triples.tsv|input_triples.nt.gz input_cardinalities.tsv evaluation_triples.tsv output.tsv" << std::endl;
+        std::cerr << argv[0] << " [--threads N] [--sample-rate R] [--counters rules.counters [--delta appended.tsv]] --snapshot input.snapshot evaluation_triples.tsv output.tsv" << std::endl;
         return EXIT_FAILURE;
     }
-    std::string input_triples_file(argv[1]);
-    std::string input_cardinalities_file(argv[2]);
-    std::string eval_triples_file(argv[3]);
-    std::string output_file(argv[4]);
+    size_t argument = 0;
+    std::string input_triples_file = use_snapshot ? "" : arguments[argument++];
+    std::string input_cardinalities_file = use_snapshot ? "" : arguments[argument++];
+    std::string eval_triples_file(arguments[argument++]);
+    std::string output_file(arguments[argument++]);
 
     try {
         std::shared_ptr<TripleStore> input_triples = std::make_shared<TripleStore>();
-        input_triples->loadFile(input_triples_file);
-
         std::shared_ptr<CardinalitiesStore> input_cardinalities = std::make_shared<CardinalitiesStore>(input_triples);
-        input_cardinalities->loadFile(input_cardinalities_file);
+        size_t entity_count;
+        if (use_snapshot) {
+            SnapshotReader snapshot(command_line.getOption("snapshot"));
+            input_triples->readFrom(snapshot);
+            input_cardinalities->addStatements(snapshot.getSection<CardinalityStatement>(CARDINALITY_STATEMENTS));
+            const auto snapshot_entity_count = snapshot.getSection<uint64_t>(EXACT_CARDINALITIES_ENTITY_COUNT);
+            entity_count = snapshot_entity_count.empty() ? input_triples->getNumberOfEntities() : snapshot_entity_count[0];
+        } else {
+            load_triples(input_triples_file, *input_triples, get_ntriples_filter(command_line));
+            input_cardinalities->loadFile(input_cardinalities_file);
+            entity_count = input_triples->getNumberOfEntities();
+        }
+
+        //The evaluation triples share the dictionary of the input ones to be queried with the same ids
+        std::shared_ptr<TripleStore> eval_triples = std::make_shared<TripleStore>(false, input_triples->getDictionary());
+        eval_triples->loadFile(eval_triples_file, true);
 
-        std::shared_ptr<TripleStore> eval_triples = std::make_shared<TripleStore>();
-        eval_triples->loadFile(eval_triples_file);
+        CardinalityRuleMining ruleMining(input_triples, input_cardinalities, entity_count);
+        const size_t threads_count = command_line.hasOption("threads") ?
+                                     std::stoul(command_line.getOption("threads")) :
+                                     std::max(1u, std::thread::hardware_concurrency());
+        const double sample_rate = std::stod(command_line.getOption("sample-rate", "1"));
+        if (sample_rate <= 0 || sample_rate > 1) {
+            std::cerr << "the sample rate should be in (0, 1]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        //The counters of the rules are saved to be updated by the next run when some lines are appended to the inputs
+        MiningCounters previous_counters;
+        MiningCounters counters;
+        AppendedLines appended_lines;
+        if (command_line.hasOption("counters")) {
+            if (sample_rate != 1) {
+                std::cerr << "the rule counters could not be computed on a sample" << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (command_line.hasOption("delta")) {
+                previous_counters = load_mining_counters(command_line.getOption("counters"), *input_triples);
+                appended_lines = read_appended_lines(command_line.getOption("delta"), *input_triples);
+                ruleMining.reuseCounters(previous_counters, appended_lines);
+            }
+            ruleMining.recordCounters(counters);
+        } else if (command_line.hasOption("delta")) {
+            std::cerr << "--delta requires the --counters of the previous run" << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto result = ruleMining.doMining(1000, threads_count, sample_rate);
+        if (command_line.hasOption("counters")) {
+            save_mining_counters(command_line.getOption("counters"), counters, *input_triples);
+        }
 
-        CardinalityRuleMining ruleMining(input_triples, input_cardinalities);
-        auto result = ruleMining.doMining(1000);
+        const auto evaluations = evaluate_rules(result, input_triples, eval_triples, threads_count);
 
         std::ofstream output_stream(output_file);
         if (!output_stream.is_open()) {
@@ -298,7 +1088,8 @@ int main(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
         output_stream << "p\tq\tr\tsupport\tbody support\thead coverage\tstd conf\tpca conf\tcompl conf\tprecision\trecall\tdir metric\tdir coef\trule eval\n";
-        for (const auto &rule : result) {
+        for (size_t i = 0; i < result.size(); i++) {
+            const auto &rule = result[i];
             output_stream << input_triples->getNodeForId(rule.p) << "\t" << input_triples->getNodeForId(rule.q)
                           << "\t" << input_triples->getNodeForId(rule.r) << "\t" << rule.support << "\t"
                           << rule.body_support << "\t" << rule.head_coverage << "\t"
@@ -306,7 +1097,7 @@ int main(int argc, char *argv[]) {
                           << rule.completeness_confidence << "\t"
                           << rule.precision << "\t" << rule.recall << "\t"
                           << rule.directional_metric << "\t" << rule.directional_coef << "\t"
-                          << evaluate_rule(rule, input_triples, eval_triples) << "\n";
+                          << evaluations[i] << "\n";
         }
         output_stream.close();
         return EXIT_SUCCESS;
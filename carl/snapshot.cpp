@@ -0,0 +1,77 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "snapshot.h"
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "snapshots are only supported on 64 bits platforms");
+
+namespace {
+const char SNAPSHOT_MAGIC[8] = {'C', 'A', 'R', 'L', 'S', 'N', 'A', 'P'};
+const size_t SECTION_ALIGNMENT = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sections_count;
+    uint64_t table_offset;
+};
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &file_name) : file_name(file_name),
+                                                               output_stream(file_name, std::ios::binary) {
+    if (!output_stream.is_open()) {
+        throw std::runtime_error(file_name + " is not writable.");
+    }
+    const SnapshotHeader header = {};
+    output_stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void SnapshotWriter::addRawSection(const uint32_t id, const char *data, const size_t size) {
+    const uint64_t offset = (uint64_t) output_stream.tellp();
+    output_stream.write(data, size);
+    const char padding[SECTION_ALIGNMENT] = {};
+    output_stream.write(padding, (SECTION_ALIGNMENT - size % SECTION_ALIGNMENT) % SECTION_ALIGNMENT);
+    sections.push_back({id, 0, offset, size});
+}
+
+void SnapshotWriter::close() {
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.sections_count = (uint32_t) sections.size();
+    header.table_offset = (uint64_t) output_stream.tellp();
+    output_stream.write(reinterpret_cast<const char *>(sections.data()), sections.size() * sizeof(SnapshotSectionEntry));
+    output_stream.seekp(0);
+    output_stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output_stream.close();
+    if (!output_stream) {
+        throw std::runtime_error("error while writing " + file_name + ".");
+    }
+}
+
+SnapshotReader::SnapshotReader(const std::string &file_name) : file(std::make_shared<MappedFile>(file_name)) {
+    SnapshotHeader header;
+    if (file->size() < sizeof(header)) {
+        throw std::runtime_error(file_name + " is not a CARL snapshot.");
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error(file_name + " is not a CARL snapshot.");
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error(file_name + " has the snapshot format version " + std::to_string(header.version) +
+                                 " but version " + std::to_string(SNAPSHOT_VERSION) +
+                                 " is expected. Please rebuild it with carl-snapshot.");
+    }
+    if (header.table_offset + header.sections_count * sizeof(SnapshotSectionEntry) > file->size()) {
+        throw std::runtime_error(file_name + " is truncated.");
+    }
+    for (uint32_t i = 0; i < header.sections_count; i++) {
+        SnapshotSectionEntry entry;
+        std::memcpy(&entry, file->data() + header.table_offset + i * sizeof(SnapshotSectionEntry), sizeof(SnapshotSectionEntry));
+        if (entry.offset + entry.size > header.table_offset) {
+            throw std::runtime_error(file_name + " is truncated.");
+        }
+        sections[entry.id] = std::make_pair(entry.offset, entry.size);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+//Binary snapshot of the loaded data.
+//Layout: a header (magic, version, sections count, offset of the sections table), the sections content aligned
+//on 8 bytes and the sections table. Sections are raw arrays of fixed size values in native byte order.
+const uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotSection : uint32_t {
+    DICTIONARY_ARENA = 1,
+    DICTIONARY_OFFSETS = 2,
+    DICTIONARY_TABLE = 3,
+    PROPERTIES = 4,
+    PSO_INDEX = 10, //5 sections, see AdjacencyIndex
+    POS_INDEX = 20, //5 sections, only if the inverse index has been built
+    CARDINALITY_STATEMENTS = 30,
+    EXACT_CARDINALITIES_ENTITY_COUNT = 31 //Number of nodes in the triples and the exact cardinality statements
+};
+
+struct SnapshotSectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string &file_name);
+
+    template <typename T>
+    void addSection(const uint32_t id, const T *data, const size_t count) {
+        addRawSection(id, reinterpret_cast<const char *>(data), count * sizeof(T));
+    }
+
+    template <typename T>
+    void addSection(const uint32_t id, const MappableVector<T> &values) {
+        addSection(id, values.data(), values.size());
+    }
+
+    //Writes the sections table and closes the file
+    void close();
+
+private:
+    void addRawSection(uint32_t id, const char *data, size_t size);
+
+    std::string file_name;
+    std::ofstream output_stream;
+    std::vector<SnapshotSectionEntry> sections;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string &file_name);
+
+    //Returns a view on the section content backed by the mapped file. Missing sections are empty
+    template <typename T>
+    MappableVector<T> getSection(const uint32_t id) const {
+        const auto iter = sections.find(id);
+        if (iter == sections.end()) {
+            return MappableVector<T>();
+        }
+        return MappableVector<T>(reinterpret_cast<const T *>(file->data() + iter->second.first),
+                                 iter->second.second / sizeof(T), file);
+    }
+
+private:
+    std::shared_ptr<MappedFile> file;
+    std::map<uint32_t, std::pair<uint64_t, uint64_t>> sections;
+};
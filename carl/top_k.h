@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+//Keeps the k best values pushed, in memory proportional to k.
+//Better is a strict weak ordering where better(a, b) means a is ranked before b. Ties are broken by push order.
+template <typename T, typename Better>
+class TopK {
+public:
+    explicit TopK(const size_t k, const Better &better = Better()) : k(k), better(better) {}
+
+    inline bool isFull() const {
+        return heap.size() >= k;
+    }
+
+    //The worst kept value, the one a new value should beat once the top is full
+    inline const T &worst() const {
+        return heap.front().first;
+    }
+
+    void push(const T &value) {
+        if (k == 0) {
+            return;
+        }
+        if (!isFull()) {
+            heap.emplace_back(value, pushed++);
+            std::push_heap(heap.begin(), heap.end(), comparator());
+        } else if (better(value, worst())) {
+            std::pop_heap(heap.begin(), heap.end(), comparator());
+            heap.back() = std::make_pair(value, pushed++);
+            std::push_heap(heap.begin(), heap.end(), comparator());
+        } else {
+            pushed++;
+        }
+    }
+
+    //Returns the kept values from the best to the worst
+    std::vector<T> sorted() const {
+        auto entries = heap;
+        std::sort(entries.begin(), entries.end(), comparator());
+        std::vector<T> values;
+        values.reserve(entries.size());
+        for (const auto &entry : entries) {
+            values.push_back(entry.first);
+        }
+        return values;
+    }
+
+private:
+    typedef std::pair<T, size_t> Entry;
+
+    //Ranks the entries from the best to the worst, the heap top being then the worst
+    struct EntryComparator {
+        const Better *better;
+
+        inline bool operator()(const Entry &a, const Entry &b) const {
+            return (*better)(a.first, b.first) || (!(*better)(b.first, a.first) && a.second < b.second);
+        }
+    };
+
+    inline EntryComparator comparator() const {
+        return {&better};
+    }
+
+    size_t k;
+    Better better;
+    size_t pushed = 0;
+    std::vector<Entry> heap;
+};
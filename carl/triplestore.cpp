@@ -1,51 +1,224 @@
 // Author: Thomas Pellissier Tanon
 
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <thread>
 
 #include "triplestore.h"
+#include "mapped_file.h"
+#include "snapshot.h"
 
-void TripleStore::loadFile(const std::string &file_name) {
-    std::ifstream input_stream(file_name);
-    if (!input_stream.is_open()) {
-        throw std::runtime_error(file_name + " is not readable.");
+namespace {
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+const TripleStore::node_id UNKNOWN_NODE = std::numeric_limits<TripleStore::node_id>::max();
+
+//Triples of a chunk of a file with ids local to the chunk, given in the order of first appearance
+struct ParsedChunk {
+    Dictionary dictionary;
+    std::vector<std::array<TripleStore::node_id, 3>> triples;
+
+    void parse(const char *begin, const char *end) {
+        std::experimental::string_view s, p, o;
+        while (begin != end) {
+            if (read_triple_line(begin, end, s, p, o)) {
+                const auto s_ = dictionary.getIdForNode(s);
+                const auto p_ = dictionary.getIdForNode(p);
+                const auto o_ = dictionary.getIdForNode(o);
+                triples.push_back({{s_, p_, o_}});
+            }
+        }
+    }
+};
+}
+
+void TripleStore::loadFile(const std::string &file_name, const bool only_known_nodes) {
+    const auto start_time = std::chrono::steady_clock::now();
+    MappedFile file(file_name);
+
+    //We tokenize the chunks in parallel and then intern their nodes in file order to get the same ids as a sequential load
+    const size_t threads_count = std::max(1u, std::thread::hardware_concurrency());
+    const auto chunks = file.splitInLines(std::min(threads_count, std::max((size_t) 1, file.size() / MIN_CHUNK_SIZE)));
+    std::vector<ParsedChunk> parsed_chunks(chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); i++) {
+        threads.emplace_back([&chunks, &parsed_chunks, i]() {
+            parsed_chunks[i].parse(chunks[i].first, chunks[i].second);
+        });
+    }
+    if (!chunks.empty()) {
+        parsed_chunks[0].parse(chunks[0].first, chunks[0].second);
+    }
+    for (auto &thread : threads) {
+        thread.join();
     }
-    std::string s, p, o;
+
     size_t i = 0;
-    std::string line;
-    while (std::getline(input_stream, line)) {
-        std::istringstream line_stream(line);
-        if(!(line_stream >> s >> p >> o)) {
-            continue;
+    size_t skipped = 0;
+    std::vector<node_id> global_ids;
+    for (auto &chunk : parsed_chunks) {
+        global_ids.clear();
+        for (node_id local_id = 0; local_id < chunk.dictionary.size(); local_id++) {
+            const auto node = chunk.dictionary.getNodeForId(local_id);
+            if (only_known_nodes) {
+                global_ids.push_back(dictionary->findIdForNode(node).value_or(UNKNOWN_NODE));
+            } else {
+                global_ids.push_back(dictionary->getIdForNode(node));
+            }
         }
-        addTriple(s, p, o);
-        i++;
-        if (i % 100000 == 0) {
-            std::cout << '*' << std::flush;
+        new_triples.reserve(new_triples.size() + chunk.triples.size());
+        for (const auto &triple : chunk.triples) {
+            const auto s = global_ids[triple[0]];
+            const auto p = global_ids[triple[1]];
+            const auto o = global_ids[triple[2]];
+            if (s == UNKNOWN_NODE || p == UNKNOWN_NODE || o == UNKNOWN_NODE) {
+                skipped++;
+                continue;
+            }
+            new_triples.push_back({p, s, o});
+            properties.insert(p);
         }
+        i += chunk.triples.size();
+        chunk = ParsedChunk();
+    }
+    buildIndex();
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start_time;
+    std::cout << i << " facts imported in " << duration.count() << "s (" << (size_t) (i / duration.count())
+              << " facts/s)" << std::endl;
+    if (skipped > 0) {
+        std::cout << skipped << " facts with unknown nodes skipped" << std::endl;
     }
-    input_stream.close();
-    std::cout << std::endl << i << " facts imported" << std::endl;
 }
 
-void TripleStore::addTriple(const std::string &subject, const std::string &predicate, const std::string &object) {
+void TripleStore::addTriple(std::experimental::string_view subject, std::experimental::string_view predicate,
+                            std::experimental::string_view object) {
     const auto s = getIdForNode(subject);
     const auto p = getIdForNode(predicate);
     const auto o = getIdForNode(object);
 
-    pso[p][s].insert(o);
+    new_triples.push_back({p, s, o});
     properties.insert(p);
 }
 
-TripleStore::node_id TripleStore::getIdForNode(const std::string &node) {
-    if (node[0] == '<' && node[node.size() - 1] == '>') {
-        return getIdForNode(node.substr(1, node.size() - 2));
+void TripleStore::buildIndex() {
+    if (with_inverse_index) {
+        std::vector<AdjacencyIndex::Triple> inverse_triples;
+        inverse_triples.reserve(new_triples.size());
+        for (const auto &triple : new_triples) {
+            inverse_triples.push_back({triple.key, triple.object, triple.subject});
+        }
+        pos.build(inverse_triples);
+    }
+    pso.build(new_triples);
+}
+
+void TripleStore::writeTo(SnapshotWriter &writer) const {
+    dictionary->writeTo(writer);
+    const std::vector<node_id> properties_list(properties.begin(), properties.end());
+    writer.addSection(PROPERTIES, properties_list.data(), properties_list.size());
+    pso.writeTo(writer, PSO_INDEX);
+    if (with_inverse_index) {
+        pos.writeTo(writer, POS_INDEX);
+    }
+}
+
+void TripleStore::readFrom(const SnapshotReader &reader) {
+    dictionary->readFrom(reader);
+    const auto properties_list = reader.getSection<node_id>(PROPERTIES);
+    properties = std::set<node_id>(properties_list.begin(), properties_list.end());
+    pso.readFrom(reader, PSO_INDEX);
+    if (with_inverse_index) {
+        pos.readFrom(reader, POS_INDEX);
+        if (pos.getKeys().empty() && !pso.getKeys().empty()) {
+            //The snapshot has been built without the POS index
+            for (const auto p : pso.getKeys()) {
+                for (const auto so : pso.get(p)) {
+                    for (const auto o : so.objects) {
+                        new_triples.push_back({p, o, so.subject});
+                    }
+                }
+            }
+            pos.build(new_triples);
+        }
+    }
+}
+
+void AdjacencyIndex::build(std::vector<Triple> &new_triples) {
+    if (new_triples.empty()) {
+        return;
+    }
+
+    //We merge the already indexed triples with the new ones
+    std::vector<Triple> triples;
+    triples.reserve(objects.size() + new_triples.size());
+    for (size_t k = 0; k < keys.size(); k++) {
+        for (size_t s = key_offsets[k]; s < key_offsets[k + 1]; s++) {
+            for (size_t o = subject_offsets[s]; o < subject_offsets[s + 1]; o++) {
+                triples.push_back({keys[k], subjects[s], objects[o]});
+            }
+        }
+    }
+    triples.insert(triples.end(), new_triples.begin(), new_triples.end());
+    new_triples.clear();
+    new_triples.shrink_to_fit();
+    std::sort(triples.begin(), triples.end());
+    triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+
+    std::vector<node_id> new_keys;
+    std::vector<size_t> new_key_offsets;
+    std::vector<node_id> new_subjects;
+    std::vector<size_t> new_subject_offsets;
+    std::vector<node_id> new_objects;
+    new_objects.reserve(triples.size());
+    for (size_t i = 0; i < triples.size(); i++) {
+        const auto &triple = triples[i];
+        if (i == 0 || triple.key != triples[i - 1].key) {
+            new_keys.push_back(triple.key);
+            new_key_offsets.push_back(new_subjects.size());
+        }
+        if (i == 0 || triple.key != triples[i - 1].key || triple.subject != triples[i - 1].subject) {
+            new_subjects.push_back(triple.subject);
+            new_subject_offsets.push_back(new_objects.size());
+        }
+        new_objects.push_back(triple.object);
     }
+    new_key_offsets.push_back(new_subjects.size());
+    new_subject_offsets.push_back(new_objects.size());
+    new_subjects.shrink_to_fit();
+    new_subject_offsets.shrink_to_fit();
+
+    keys = std::move(new_keys);
+    key_offsets = std::move(new_key_offsets);
+    subjects = std::move(new_subjects);
+    subject_offsets = std::move(new_subject_offsets);
+    objects = std::move(new_objects);
+}
 
-    if (!map_has_key(id_for_nodes, node)) {
-        id_for_nodes[node] = nodes.size();
-        nodes.push_back(node);
+Relation AdjacencyIndex::get(const node_id key) const {
+    const auto iter = std::lower_bound(keys.begin(), keys.end(), key);
+    if (iter == keys.end() || *iter != key) {
+        return Relation();
     }
-    return id_for_nodes[node];
+    const size_t k = iter - keys.begin();
+    return Relation(subjects.data() + key_offsets[k], key_offsets[k + 1] - key_offsets[k],
+                    subject_offsets.data() + key_offsets[k], objects.data());
+}
+
+void AdjacencyIndex::writeTo(SnapshotWriter &writer, const uint32_t first_section) const {
+    writer.addSection(first_section, keys);
+    writer.addSection(first_section + 1, key_offsets);
+    writer.addSection(first_section + 2, subjects);
+    writer.addSection(first_section + 3, subject_offsets);
+    writer.addSection(first_section + 4, objects);
+}
+
+void AdjacencyIndex::readFrom(const SnapshotReader &reader, const uint32_t first_section) {
+    keys = reader.getSection<node_id>(first_section);
+    key_offsets = reader.getSection<size_t>(first_section + 1);
+    subjects = reader.getSection<node_id>(first_section + 2);
+    subject_offsets = reader.getSection<size_t>(first_section + 3);
+    objects = reader.getSection<node_id>(first_section + 4);
 }
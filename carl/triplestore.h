@@ -5,7 +5,14 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <string>
+#include <memory>
+#include <algorithm>
 #include <experimental/optional>
+#include <experimental/string_view>
+
+#include "dictionary.h"
+#include "mapped_file.h"
 
 template <class _Key, class _Tp, class _Compare, class _Allocator>
 inline bool map_has_key(const std::map<_Key, _Tp, _Compare, _Allocator>& map, const _Key& key) {
@@ -48,40 +55,239 @@ inline bool set_contains(const std::set<_Key, _Compare, _Allocator>& set, const
 }
 
 
+//Sorted range of node ids stored contiguously in memory
+class IdRange {
+public:
+    IdRange() : first(nullptr), last(nullptr) {}
+
+    IdRange(const node_id *first, const node_id *last) : first(first), last(last) {}
+
+    inline const node_id *begin() const {
+        return first;
+    }
+
+    inline const node_id *end() const {
+        return last;
+    }
+
+    inline size_t size() const {
+        return last - first;
+    }
+
+    inline bool empty() const {
+        return first == last;
+    }
+
+    inline bool contains(const node_id id) const {
+        return std::binary_search(first, last, id);
+    }
+
+private:
+    const node_id *first;
+    const node_id *last;
+};
+
+//Read-only view on the subject -> objects adjacency of one property in the compressed sparse row layout
+class Relation {
+public:
+    struct Entry {
+        node_id subject;
+        IdRange objects;
+    };
+
+    class const_iterator {
+    public:
+        const_iterator(const Relation &relation, size_t position) : relation(relation), position(position) {}
+
+        inline Entry operator*() const {
+            return {relation.subjects[position], relation.getObjectsAt(position)};
+        }
+
+        inline const_iterator &operator++() {
+            position++;
+            return *this;
+        }
+
+        inline bool operator==(const const_iterator &other) const {
+            return position == other.position;
+        }
+
+        inline bool operator!=(const const_iterator &other) const {
+            return position != other.position;
+        }
+
+    private:
+        const Relation &relation;
+        size_t position;
+    };
+
+    Relation() : subjects(nullptr), subjects_count(0), offsets(nullptr), objects(nullptr) {}
+
+    Relation(const node_id *subjects, size_t subjects_count, const size_t *offsets, const node_id *objects) :
+            subjects(subjects), subjects_count(subjects_count), offsets(offsets), objects(objects) {}
+
+    inline const_iterator begin() const {
+        return const_iterator(*this, 0);
+    }
+
+    inline const_iterator end() const {
+        return const_iterator(*this, subjects_count);
+    }
+
+    inline size_t getNumberOfSubjects() const {
+        return subjects_count;
+    }
+
+    inline size_t getNumberOfTriples() const {
+        return subjects_count == 0 ? 0 : offsets[subjects_count] - offsets[0];
+    }
+
+    inline IdRange getSubjects() const {
+        return IdRange(subjects, subjects + subjects_count);
+    }
+
+    inline IdRange getObjectsAt(size_t position) const {
+        return IdRange(objects + offsets[position], objects + offsets[position + 1]);
+    }
+
+    inline IdRange getObjects(const node_id subject) const {
+        const auto last = subjects + subjects_count;
+        const auto iter = std::lower_bound(subjects, last, subject);
+        if (iter == last || *iter != subject) {
+            return IdRange();
+        }
+        return getObjectsAt(iter - subjects);
+    }
+
+    inline bool contains(const node_id subject, const node_id object) const {
+        return getObjects(subject).contains(object);
+    }
+
+private:
+    const node_id *subjects;
+    size_t subjects_count;
+    const size_t *offsets;
+    const node_id *objects;
+};
+
+//Frozen key -> subject -> objects index in the compressed sparse row layout:
+//keys are sorted, and for each key the subjects then the objects of each subject are stored sorted in flat arrays
+class AdjacencyIndex {
+public:
+    struct Triple {
+        node_id key;
+        node_id subject;
+        node_id object;
+
+        inline bool operator<(const Triple &other) const {
+            return key < other.key || (key == other.key && (subject < other.subject ||
+                                                             (subject == other.subject && object < other.object)));
+        }
+
+        inline bool operator==(const Triple &other) const {
+            return key == other.key && subject == other.subject && object == other.object;
+        }
+    };
+
+    //Rebuilds the index from its current content and the new triples
+    void build(std::vector<Triple> &new_triples);
+
+    Relation get(const node_id key) const;
+
+    inline IdRange getKeys() const {
+        return IdRange(keys.begin(), keys.end());
+    }
+
+    //Uses the five sections starting at first_section
+    void writeTo(SnapshotWriter &writer, uint32_t first_section) const;
+
+    void readFrom(const SnapshotReader &reader, uint32_t first_section);
+
+private:
+    MappableVector<node_id> keys;
+    MappableVector<size_t> key_offsets;
+    MappableVector<node_id> subjects;
+    MappableVector<size_t> subject_offsets;
+    MappableVector<node_id> objects;
+};
+
+
 class TripleStore {
 public:
-    typedef unsigned int node_id;
+    typedef ::node_id node_id;
+
+    //The POS index is only built if with_inverse_index is set.
+    //Stores sharing the same dictionary could be queried with the same node ids.
+    explicit TripleStore(bool with_inverse_index = false,
+                         std::shared_ptr<Dictionary> dictionary = std::make_shared<Dictionary>()) :
+            with_inverse_index(with_inverse_index), dictionary(dictionary) {}
+
+    //If only_known_nodes is set, the dictionary is not modified and the triples with unknown nodes are skipped
+    void loadFile(const std::string &file_name, bool only_known_nodes = false);
+
+    //The triple is only visible after the next call to buildIndex
+    void addTriple(std::experimental::string_view subject, std::experimental::string_view predicate,
+                   std::experimental::string_view object);
 
-    std::map<node_id, std::map<node_id, std::set<node_id>>> pso;
+    //Freezes the added triples into the read-optimized index
+    void buildIndex();
 
-    void loadFile(const std::string &file_name);
+    void writeTo(SnapshotWriter &writer) const;
 
-    void addTriple(const std::string &subject, const std::string &predicate, const std::string &object);
+    //The indexes are used directly from the mapped snapshot
+    void readFrom(const SnapshotReader &reader);
 
-    inline const std::string &getNodeForId(const TripleStore::node_id id) const {
-        return nodes[id];
+    inline bool hasInverseIndex() const {
+        return with_inverse_index;
     }
 
-    node_id getIdForNode(const std::string &node);
+    inline Relation getRelation(const node_id property) const {
+        return pso.get(property);
+    }
+
+    //Object -> subjects adjacency of the property. Requires with_inverse_index
+    inline Relation getInverseRelation(const node_id property) const {
+        return pos.get(property);
+    }
+
+    inline std::experimental::string_view getNodeForId(const TripleStore::node_id id) const {
+        return dictionary->getNodeForId(id);
+    }
+
+    inline node_id getIdForNode(const std::experimental::string_view node) {
+        return dictionary->getIdForNode(node);
+    }
+
+    inline const std::shared_ptr<Dictionary> &getDictionary() const {
+        return dictionary;
+    }
 
+    //Number of nodes in the dictionary, including the ones of the other stores sharing it
     inline size_t getNumberOfEntities() const {
-        return nodes.size();
+        return dictionary->size();
     }
 
     inline const std::set<node_id>& getProperties() const {
         return properties;
     }
 
-    inline bool contains(const std::string &subject, const std::string &predicate, const std::string &object) {
-        return contains(getIdForNode(subject), getIdForNode(predicate), getIdForNode(object));
+    inline bool contains(std::experimental::string_view subject, std::experimental::string_view predicate,
+                         std::experimental::string_view object) const {
+        const auto s = dictionary->findIdForNode(subject);
+        const auto p = dictionary->findIdForNode(predicate);
+        const auto o = dictionary->findIdForNode(object);
+        return s && p && o && contains(*s, *p, *o);
     }
 
-    inline bool contains(const TripleStore::node_id subject, const TripleStore::node_id predicate, const TripleStore::node_id object) {
-        return map_has_key(pso[predicate], subject) && set_contains(pso[predicate][subject], object);
+    inline bool contains(const TripleStore::node_id subject, const TripleStore::node_id predicate, const TripleStore::node_id object) const {
+        return pso.get(predicate).contains(subject, object);
     }
 
 private:
-    std::vector<std::string> nodes;
-    std::map<std::string, node_id> id_for_nodes;
+    bool with_inverse_index;
+    AdjacencyIndex pso;
+    AdjacencyIndex pos;
+    std::vector<AdjacencyIndex::Triple> new_triples;
+    std::shared_ptr<Dictionary> dictionary;
     std::set<node_id> properties;
 };